@@ -0,0 +1,67 @@
+#ifndef BATTERY_SOC_H
+#define BATTERY_SOC_H
+
+#include <stdint.h>
+
+// --- Battery State-of-Charge Estimator ---
+// Streaming SoC engine for the battery channel. Plain C++ with no Arduino
+// dependencies, so recorded (voltage, current, timestamp) traces can be fed
+// through it on a PC. Every update is O(1) in time and memory.
+//
+//  - Coulomb counting on the signed current (positive = charging), with a
+//    charge efficiency applied to current going in.
+//  - When the battery has rested (|I| small for long enough), the SoC is
+//    pulled towards the open-circuit-voltage estimate to cancel drift.
+//  - Reaching full (absorption voltage with only a tail current) re-syncs to
+//    100% and, if the previous cycle also started full, measures the real
+//    round-trip efficiency.
+//  - Time-to-empty / time-to-full come from an exponentially weighted linear
+//    regression of SoC over time, updated incrementally.
+
+static const int BATTERY_OCV_POINTS = 6;
+static const float BATTERY_TREND_STEP_S = 10.0f;
+
+struct BatteryModel {
+  float capacity_mah;
+  float ocv_volts[BATTERY_OCV_POINTS];   // Rested voltage, ascending
+  float ocv_soc[BATTERY_OCV_POINTS];     // SoC (0-1) at each voltage
+  float rest_current_ma;                 // Below this the battery is resting
+  uint32_t rest_time_s;                  // Rest this long before trusting OCV
+  float ocv_time_constant_s;             // How quickly rested SoC converges on OCV
+  float full_voltage;                    // Absorption voltage that counts as full...
+  float full_tail_current_ma;            // ...once charge current has tapered below this
+  float initial_efficiency;              // Charge efficiency before one is measured
+  float trend_time_constant_s;           // Memory of the TTE/TTF regression
+};
+
+struct BatterySoc {
+  double soc;              // 0-1; double so sub-mA steps at 28 Hz aren't rounded away
+  float efficiency;        // Charge efficiency in use (0-1)
+  float tte_hours;         // Time to empty, 0 if not discharging
+  float ttf_hours;         // Time to full, 0 if not charging
+
+  // Internal state
+  bool started;
+  uint32_t last_time_us;
+  uint64_t rest_us;        // Time spent below rest_current_ma, capped at rest_time_s
+  bool cycle_from_full;    // The running in/out totals started at 100%
+  float cycle_in_mah;
+  float cycle_out_mah;
+
+  // Weighted regression sums, times in hours relative to the latest point.
+  // Points are added every BATTERY_TREND_STEP_S, not per sample, to keep floats well-conditioned.
+  float trend_pending_hours;
+  float s_w, s_t, s_tt, s_y, s_ty;
+};
+
+// Starts at the OCV estimate for `voltage` (no better guess at boot)
+void battery_soc_init(BatterySoc& state, const BatteryModel& model, float voltage);
+
+// Feeds one sample; timestamp_us is a free-running micros() value, wrap-safe
+void battery_soc_update(BatterySoc& state, const BatteryModel& model,
+                        float voltage, float current_ma, uint32_t timestamp_us);
+
+// SoC (0-1) for a rested battery at `voltage`, by linear interpolation
+float battery_ocv_soc(const BatteryModel& model, float voltage);
+
+#endif // BATTERY_SOC_H
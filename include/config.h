@@ -3,12 +3,16 @@
 
 #include <stdint.h>
 
-static const int DEVICE_DISCOVERY_PAYLOAD_SIZE = 7168; // Size of the JSON payload for MQTT Discovery
+static const int MQTT_BUFFER_SIZE = 512; // PubSubClient buffer; discovery (~8.5 KB) is streamed past it
+static const int MQTT_MAX_TOPIC_LENGTH = 96;    // Longest topic mqtt_publish() accepts (+1 for the terminator)
+static const int MQTT_MAX_PAYLOAD_LENGTH = 384; // Longest queued payload (a channel's JSON state is ~250)
+static const int MQTT_MAX_INBOUND_LENGTH = 64;  // Longest subscribed payload kept (states are a few bytes)
 
 // ESP32 DevKitC
 // I2C
 extern const int I2C_SDA_PIN;
 extern const int I2C_SCL_PIN;
+extern const uint32_t I2C_CLOCK_HZ;
 
 // Rotary Encoder
 extern const int ENCODER_CLK_PIN;
@@ -16,7 +20,6 @@ extern const int ENCODER_DT_PIN;
 extern const int ENCODER_SW_PIN;
 
 // INA226 Alert Pins
-extern const int INA_ALERT_PIN_CH1;
 extern const int INA_ALERT_PIN_CH2;
 extern const int INA_ALERT_PIN_CH3;
 
@@ -37,6 +40,10 @@ extern const int OLED_I2C_ADDRESS;
 // --- Wi-Fi Credentials ---
 extern const char* WIFI_SSID;
 extern const char* WIFI_PASSWORD;
+extern const unsigned long WIFI_CONNECT_TIMEOUT;   // ms per attempt before backing off
+extern const unsigned long WIFI_FAST_CONNECT_TIMEOUT; // ms for the cached BSSID/channel attempt
+extern const unsigned long WIFI_BACKOFF_MIN;       // ms, doubled after each failed attempt
+extern const unsigned long WIFI_BACKOFF_MAX;
 
 // --- MQTT Broker Settings ---
 extern const char* MQTT_SERVER;
@@ -46,12 +53,85 @@ extern const char* DEVICE_ID;
 
 
 // --- Power Monitor ---
+// Supported current/power monitor chips. Each has a static driver in power_drivers.h.
+enum PowerChipType {
+  CHIP_INA219,
+  CHIP_INA226,
+  CHIP_INA3221  // Three inputs behind one address, selected by `input`
+};
+
+// What a channel measures; picks its overview card and colour on the display
+enum PowerChannelRole {
+  CHANNEL_SOURCE,   // Generation, e.g. solar: power first
+  CHANNEL_BATTERY,  // Storage: voltage first, with the charge level icon
+  CHANNEL_LOAD      // Consumption: current first
+};
+
+// One row per measured shunt. Everything the power monitor does (sampling,
+// energy, publishing, availability) and every power screen iterates this table.
+struct PowerChannelConfig {
+  const char* name;          // Human-readable label for logs
+  const char* label;         // Short upper-case name for the display
+  PowerChannelRole role;
+  PowerChipType chip;
+  uint8_t address;           // I2C address
+  uint8_t input;             // INA3221 input 0-2, ignored for single-channel chips
+  float shunt_ohms;
+  int alert_pin;             // Conversion-ready ALERT GPIO (INA226 only), -1 to poll
+  bool bidirectional;        // Split energy into charged/discharged instead of a net total
+  float capture_limit_a;     // Transient capture trigger (INA226 with ALERT), 0 = off, negative = discharge side
+
+  // Channel-wide MQTT topics; the per-measurement ones live in SENSORS
+  const char* availability_topic;
+  const char* attributes_topic;  // Window min/max, linked to the power sensor as json_attr_t
+  const char* state_topic;       // Combined JSON document (ENABLE_JSON_STATE)
+};
+
+static const int NUM_POWER_CHANNELS = 3; // Checked against the table in config.cpp
+extern const PowerChannelConfig POWER_CHANNELS[NUM_POWER_CHANNELS];
+
+// --- Sensor Registry ---
+// One row per published measurement of a power channel. Discovery, both
+// publish modes and the channel screen iterate this table; nothing else
+// spells out a measurement's topic, unit or precision.
+enum MeasurementKind {
+  MEASURE_VOLTAGE,     // Window mean, mV
+  MEASURE_CURRENT,     // Window mean, uA
+  MEASURE_POWER,       // Window mean, mW
+  MEASURE_ENERGY,      // Net total, uWh (unidirectional channels)
+  MEASURE_ENERGY_IN,   // Total while current is positive, uWh (bidirectional)
+  MEASURE_ENERGY_OUT   // Total while current is negative, uWh (bidirectional)
+};
+
+struct PublishDeadband;
+struct SensorDef {
+  uint8_t channel;               // Index into POWER_CHANNELS
+  MeasurementKind kind;
+  const char* unique_id;         // Discovery component key and uniq_id
+  const char* object_id;
+  const char* name;
+  const char* icon;
+  const char* state_topic;       // Per-topic mode
+  const char* json_key;          // Field in the channel's JSON state document
+  const char* json_template;     // val_tpl for that field
+  const char* device_class;
+  const char* unit;
+  const char* state_class;
+  uint8_t scale;                 // Fixed-point reading / 10^scale = value in `unit`
+  uint8_t decimals;              // Published precision
+  const PublishDeadband* deadband;
+  bool attributes;               // Carries the window min/max (json_attr_t)
+};
+
+static const int NUM_SENSORS = 13; // 4 per unidirectional channel, 5 per bidirectional; checked in config.cpp
+extern const SensorDef SENSORS[NUM_SENSORS];
+
 extern const uint8_t INA226_CH1_ADDRESS;
 extern const uint8_t INA226_CH2_ADDRESS;
 extern const uint8_t INA226_CH3_ADDRESS;
-extern const float INA226_CH1_SHUNT;
 extern const float INA226_CH2_SHUNT;
 extern const float INA226_CH3_SHUNT;
+extern const float INA219_CH1_SHUNT;
 
 // --- Application Logic Constants ---
 extern unsigned long MOTION_TIMER_DURATION;
@@ -60,6 +140,61 @@ extern const int NUM_MODES;
 extern const unsigned long INACTIVITY_TIMEOUT;
 extern const int DISPLAY_UPDATE_INTERVAL;
 
+// --- Sample / Publish Rates ---
+// Sampling feeds energy integration and the publish window; publishing only
+// sends the window's mean (state) and min/max (attributes).
+extern const unsigned long POWER_POLL_INTERVAL;
+extern const unsigned long POWER_PUBLISH_WINDOW;
+extern const bool ENABLE_JSON_STATE;  // One JSON document per channel instead of one topic per value
+
+// --- Publish Filter ---
+// Per-measurement deadbands for the power monitor state topics (see publish_filter.h)
+extern const PublishDeadband VOLTAGE_DEADBAND;
+extern const PublishDeadband CURRENT_DEADBAND;
+extern const PublishDeadband POWER_DEADBAND;
+extern const PublishDeadband ENERGY_DEADBAND;
+extern const PublishDeadband SOC_DEADBAND;
+
+// --- Battery State of Charge ---
+// Model parameters for battery_soc.h
+struct BatteryModel;
+extern const int BATTERY_CHANNEL;  // 1-based channel measuring the battery
+extern const BatteryModel BATTERY_MODEL;
+
+// One row per field of the MQTT_TOPIC_BATTERY_SOC_STATE document. Discovery
+// and publish_battery_soc() iterate this table.
+enum BatteryEstimateKind {
+  ESTIMATE_SOC,            // %
+  ESTIMATE_TIME_TO_EMPTY,  // h, 0 unless discharging
+  ESTIMATE_TIME_TO_FULL,   // h, 0 unless charging
+  ESTIMATE_EFFICIENCY      // Charge efficiency, %
+};
+
+struct BatteryEstimateDef {
+  BatteryEstimateKind kind;
+  const char* unique_id;         // Discovery component key and uniq_id
+  const char* object_id;
+  const char* name;
+  const char* icon;              // nullptr: the device class default
+  const char* json_key;          // Field in the SoC document
+  const char* json_template;     // val_tpl for that field
+  const char* device_class;      // nullptr for none
+  const char* unit;
+};
+
+static const int NUM_BATTERY_ESTIMATES = 4;
+extern const BatteryEstimateDef BATTERY_ESTIMATES[NUM_BATTERY_ESTIMATES];
+
+// --- Energy Counter Persistence ---
+extern const unsigned long ENERGY_FLUSH_INTERVAL;     // Save at least this often while counters move
+extern const unsigned long ENERGY_FLUSH_MIN_INTERVAL; // Never save more often than this
+extern const uint64_t ENERGY_FLUSH_DELTA_UWH;         // Save early once this much energy is unsaved
+extern const float ENERGY_FLUSH_LOW_VOLTAGE;       // On BATTERY_CHANNEL
+
+// --- Diagnostics ---
+extern const bool ENABLE_DIAGNOSTICS;
+extern const unsigned long DIAGNOSTICS_REPORT_INTERVAL;
+
 // --- Grand Unified MQTT Topics ---
 // This new structure follows the home/[location]/[domain]/[object_id]/[message_type] pattern.
 
@@ -69,10 +204,7 @@ extern const char* MQTT_BASE_TOPIC_MOTION_TIMER;
 extern const char* MQTT_BASE_TOPIC_MANUAL_TIMER;
 
 // --- Device & Sensor Availability Topics ---
-extern const char* MQTT_TOPIC_DEVICE_AVAILABILITY;
-extern const char* MQTT_TOPIC_PANEL_SENSOR_AVAILABILITY;
-extern const char* MQTT_TOPIC_BATTERY_SENSOR_AVAILABILITY;
-extern const char* MQTT_TOPIC_LOAD_SENSOR_AVAILABILITY;
+extern const char* MQTT_TOPIC_DEVICE_AVAILABILITY;  // Per-channel ones live in POWER_CHANNELS
 
 // --- Sensor Hub Sensor Topics (Published by Sensor Hub) ---
 extern const char* MQTT_TOPIC_TEMPERATURE_SHED_STATE;
@@ -93,24 +225,16 @@ extern const char* MQTT_TOPIC_MANUAL_TIMER_COMMAND;
 extern const char* MQTT_TOPIC_TIMER_REMAINING_STATE;
 
 // --- Power Monitor Sensor Topics (Published by this device) ---
-// --- Channel 1: Solar Panel ---
-extern const char* MQTT_TOPIC_SOLAR_PANEL_VOLTAGE_STATE;
-extern const char* MQTT_TOPIC_SOLAR_PANEL_CURRENT_STATE;
-extern const char* MQTT_TOPIC_SOLAR_PANEL_POWER_STATE;
-extern const char* MQTT_TOPIC_SOLAR_PANEL_ENERGY_STATE;
-
-// --- Channel 2: Battery ---
-extern const char* MQTT_TOPIC_BATTERY_VOLTAGE_STATE;
-extern const char* MQTT_TOPIC_BATTERY_CURRENT_STATE;
-extern const char* MQTT_TOPIC_BATTERY_POWER_STATE;
-extern const char* MQTT_TOPIC_BATTERY_ENERGY_CHARGED_STATE;
-extern const char* MQTT_TOPIC_BATTERY_ENERGY_DISCHARGED_STATE;
-
-// --- Channel 3: Load ---
-extern const char* MQTT_TOPIC_LOAD_VOLTAGE_STATE;
-extern const char* MQTT_TOPIC_LOAD_CURRENT_STATE;
-extern const char* MQTT_TOPIC_LOAD_POWER_STATE;
-extern const char* MQTT_TOPIC_LOAD_ENERGY_STATE;
+// Per-measurement topics are composed in the SENSORS table (config.cpp)
+extern const char* MQTT_TOPIC_BATTERY_SOC_STATE;
+
+// --- Discovery ---
+extern const char* MQTT_TOPIC_DISCOVERY_HASH;      // Retained hash of the published discovery document
+extern const char* MQTT_TOPIC_HA_STATUS;           // Home Assistant birth/will; "online" means it (re)started
+
+// --- Store-and-Forward Replay ---
+extern const char* MQTT_TOPIC_TELEMETRY_HISTORY;
+extern const char* MQTT_TOPIC_TRANSIENT_CAPTURE;
 
 // --- MQTT Payloads ---
 extern const char* MQTT_PAYLOAD_ONLINE;
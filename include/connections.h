@@ -7,13 +7,30 @@
 #include <PubSubClient.h>
 
 // "extern" tells the compiler that this object exists, but is defined
-// in a different file (in our case, connections.cpp).
+// in a different file (in our case, main.cpp). Only the network task may use it.
 extern PubSubClient client;
 
+// Inbound message handler: a non-owning view of the payload, null-terminated at `length`
+typedef void (*MqttMessageHandler)(const char* message, unsigned int length);
+
 // This is the public list of functions available from this module.
-void setup_wifi();
-void reconnect();
+void setup_wifi();       // Starts connecting and returns; the network task finishes the job
+void setup_mqtt();       // Starts the network task, which owns `client` from then on
+void loop_mqtt();        // Runs queued inbound messages through their handlers (loop() only)
+bool wifi_connected();
+bool mqtt_connected();
+void print_connection_stats();
 void mqtt_callback(char* topic, byte* payload, unsigned int length);
 
+// Queues a message for the network task; never blocks. A value still waiting
+// for the same topic is replaced unless `coalesce` is false (for streams where
+// every message counts). Returns false if the broker is down or the outbound
+// table is full, so callers can keep the data themselves.
+bool mqtt_publish(const char* topic, const char* payload, bool retained = false, bool coalesce = true);
+
+// Adds a publish that reached the broker to the wire counters. The outbound
+// queue counts its own; streamed beginPublish()/endPublish() callers report here.
+void mqtt_count_sent(size_t topic_length, size_t payload_length);
+
 #endif // CONNECTIONS_H
 
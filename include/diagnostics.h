@@ -0,0 +1,8 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+// Periodically prints performance counters from each module to Serial.
+// Controlled by ENABLE_DIAGNOSTICS / DIAGNOSTICS_REPORT_INTERVAL in config.
+void loop_diagnostics();
+
+#endif // DIAGNOSTICS_H
@@ -1,7 +1,17 @@
 #ifndef DISCOVERY_H
 #define DISCOVERY_H
 
-// The public function that will be called from connections.cpp
+// The public functions that will be called from connections.cpp (network task only)
+// On connect: asks the broker for the hash of the config it already holds.
 void mqtt_discovery();
+// Every pass: publishes the cached discovery document once the broker turns
+// out not to have it, or when Home Assistant comes back online.
+void loop_discovery();
+
+// TOPIC_ROUTES handlers, run on the network task: the retained
+// MQTT_TOPIC_DISCOVERY_HASH payload...
+void discovery_note_broker_hash(const char* message, unsigned int length);
+// ...and Home Assistant's MQTT_TOPIC_HA_STATUS messages
+void discovery_note_ha_status(const char* message, unsigned int length);
 
 #endif // DISCOVERY_H
\ No newline at end of file
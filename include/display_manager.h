@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <TFT_eSPI.h>
+#include "config.h" // NUM_POWER_CHANNELS
 
 const int LIGHTS_MENU_ITEM_COUNT = 4;
 
@@ -10,15 +11,17 @@ const int LIGHTS_MENU_ITEM_COUNT = 4;
 // By placing these here, both main.cpp and display_manager.cpp can see them.
 enum DisplayMode {
   POWER_MODE_ALL,
-  POWER_MODE_CH1,
-  POWER_MODE_CH2,
-  POWER_MODE_CH3,
-  SENSORS_MODE,
+  POWER_MODE_CH1,  // First of NUM_POWER_CHANNELS channel screens, in table order
+  SENSORS_MODE = POWER_MODE_CH1 + NUM_POWER_CHANNELS,
   LIGHTS_MENU,
   EDIT_MOTION_TIMER,
   EDIT_MANUAL_TIMER
 };
 
+inline bool is_power_channel_mode(DisplayMode mode) {
+  return mode >= POWER_MODE_CH1 && mode < SENSORS_MODE;
+}
+
 enum PowerSubMode { 
   LIVE_POWER, 
   POWER_SUBSCREEN 
@@ -27,10 +30,11 @@ enum PowerSubMode {
 // --- Data Structure for Display Updates ---
 // This struct bundles all the data needed to draw any screen.
 struct DisplayData {
-  // Power Data
-  float busVoltage[3];
-  float current[3];
-  float power[3];
+  // Power Data (fixed-point, formatted with format_fixed())
+  int32_t busMillivolts[NUM_POWER_CHANNELS];
+  int32_t currentMilliamps[NUM_POWER_CHANNELS];
+  int32_t powerMilliwatts[NUM_POWER_CHANNELS];
+  float batterySoc;   // %, -1 if not estimated yet
   
   // Light Status Data
   bool lightIsOn;
@@ -67,6 +71,9 @@ void setup_display();
 // This is the single, high-level function that main.cpp will call to handle all drawing.
 void update_display(DisplayMode mode, PowerSubMode powerSub, const DisplayData& data);
 
+// Frames drawn, bands pushed vs. left alone, and SPI bytes sent (diagnostics)
+void print_display_stats();
+
 
 #endif // DISPLAY_MANAGER_H
 
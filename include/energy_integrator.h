@@ -0,0 +1,37 @@
+#ifndef ENERGY_INTEGRATOR_H
+#define ENERGY_INTEGRATOR_H
+
+#include <stdint.h>
+
+// --- Fixed-Point Energy Integrator ---
+// Integrates power over the real time between samples using the trapezoid
+// rule. Everything is integer math: power in mW, time in us, so one step is
+// mW * us = nJ. Whole micro-watt-hours are carried into 64-bit counters and
+// the sub-uWh remainder is kept, so nothing is lost however long it runs.
+//
+// Positive and negative power are accumulated separately (battery charge vs
+// discharge). A step whose endpoints have opposite signs is split at the zero
+// crossing so each side gets its own share.
+struct EnergyIntegrator {
+  uint64_t positive_uwh;  // Energy while power > 0 (e.g. battery charging)
+  uint64_t negative_uwh;  // Energy while power < 0 (e.g. battery discharging)
+  int64_t positive_nj;    // Sub-uWh remainders, always 0 .. NJ_PER_UWH-1
+  int64_t negative_nj;
+  int32_t last_power_mw;
+  uint32_t last_time_us;
+  bool started;
+};
+
+// Gaps longer than this (sensor offline, task starved) are not bridged;
+// integration restarts at the next sample instead of inventing a trapezoid.
+static const uint32_t ENERGY_MAX_GAP_US = 10000000; // 10s
+
+void energy_integrator_reset(EnergyIntegrator& integrator);
+
+// Adds one sample. timestamp_us is a free-running micros() value, wrap-safe.
+void energy_integrator_add(EnergyIntegrator& integrator, int32_t power_mw, uint32_t timestamp_us);
+
+// Net energy (positive minus negative) in uWh.
+int64_t energy_integrator_net_uwh(const EnergyIntegrator& integrator);
+
+#endif // ENERGY_INTEGRATOR_H
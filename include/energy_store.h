@@ -0,0 +1,20 @@
+#ifndef ENERGY_STORE_H
+#define ENERGY_STORE_H
+
+// --- Persistent Energy Counters ---
+// Keeps the per-channel energy totals in NVS so the total_increasing sensors
+// survive reboots, OTA updates and brownouts. Two journal slots are written
+// alternately, each with a sequence number and CRC, so a write torn by a power
+// cut always leaves the previous slot intact. Writes are coalesced: only when
+// the counters moved enough, or after a quiet interval, never more often than
+// ENERGY_FLUSH_MIN_INTERVAL.
+
+void setup_energy_store(); // Restores the saved totals into the power monitor
+void loop_energy_store();  // Coalesced flushes and the low-voltage flush
+
+// Writes the current totals now (if they changed). Used on OTA start and restart.
+void energy_store_flush(const char* reason);
+
+void print_energy_store_stats();
+
+#endif // ENERGY_STORE_H
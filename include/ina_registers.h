@@ -0,0 +1,47 @@
+#ifndef INA_REGISTERS_H
+#define INA_REGISTERS_H
+
+#include <stdint.h>
+
+// --- Low-Level INA219 / INA226 Register Access ---
+// The chip libraries spend a separate I2C round trip on every value and do
+// the scaling in float. These helpers read only the shunt and bus registers,
+// each as a single repeated-start transaction (pointer write + 2-byte read),
+// and compute current and power locally from the shunt resistance.
+
+// Register map (shared by both parts unless noted)
+static const uint8_t INA_REG_CONFIG = 0x00;
+static const uint8_t INA_REG_SHUNT_VOLTAGE = 0x01;
+static const uint8_t INA_REG_BUS_VOLTAGE = 0x02;
+static const uint8_t INA_REG_POWER = 0x03;
+static const uint8_t INA_REG_CURRENT = 0x04;
+static const uint8_t INA_REG_CALIBRATION = 0x05;
+static const uint8_t INA226_REG_MASK_ENABLE = 0x06; // INA226 only
+static const uint8_t INA226_REG_ALERT_LIMIT = 0x07; // INA226 only
+static const uint8_t INA3221_REG_CH1_SHUNT = 0x01;  // INA3221: input n shunt at 0x01 + 2n, bus at 0x02 + 2n
+
+// One reading in integer units
+struct InaReading {
+  int32_t bus_mv;     // Bus voltage, millivolts
+  int32_t current_ua; // Shunt current, microamps (signed)
+  int32_t power_mw;   // bus * current, milliwatts (signed)
+};
+
+// Single-transaction register access. Return false if the device NAKs.
+bool ina_read_register(uint8_t address, uint8_t reg, uint16_t& value);
+bool ina_write_register(uint8_t address, uint8_t reg, uint16_t value);
+
+// Reads whatever register the pointer was last set to. The chips keep the
+// pointer between reads, so polling one register skips the pointer write.
+bool ina_read_pointed(uint8_t address, uint16_t& value);
+
+// INA226 shunt register <-> current, for burst captures and the alert limit
+int32_t ina226_shunt_to_ua(uint16_t raw, uint32_t shunt_uohm);
+uint16_t ina226_ua_to_shunt(int32_t current_ua, uint32_t shunt_uohm);
+
+// Shunt + bus in two transactions. shunt_uohm is the shunt resistance in micro-ohms.
+bool ina226_read(uint8_t address, uint32_t shunt_uohm, InaReading& reading);
+bool ina219_read(uint8_t address, uint32_t shunt_uohm, InaReading& reading);
+bool ina3221_read(uint8_t address, uint8_t input, uint32_t shunt_uohm, InaReading& reading);
+
+#endif // INA_REGISTERS_H
@@ -0,0 +1,201 @@
+#ifndef POWER_DRIVERS_H
+#define POWER_DRIVERS_H
+
+#include <stdint.h>
+#include "config.h"
+#include "ina_registers.h"
+
+// --- Per-Chip Power Monitor Drivers ---
+// Every driver has the same static interface:
+//   begin(cfg)               - configure the chip for continuous shunt+bus conversions
+//   enable_ready_alert(cfg)  - route "conversion ready" to the ALERT pin (false if unsupported)
+//   ack_alert(cfg, flags)    - release a latched ALERT, returning what caused it (ALERT_FLAG_*)
+//   read(cfg, shunt, out)    - one reading in integer units
+// Chips with an over-current comparator also support transient capture:
+//   arm_overcurrent(cfg, limit_ua, shunt) - ALERT on |current| past the limit as well as conversion ready
+//   begin_burst(cfg) / read_burst(cfg, shunt, ua) / end_burst(cfg) - fastest shunt-only sampling
+// power_driver_*() picks the driver with a switch on the table's chip type, so
+// the sampling loop makes direct, inlinable calls instead of virtual ones.
+
+template <PowerChipType Chip>
+struct PowerDriver;
+
+// Alert causes reported by ack_alert()
+static const uint16_t ALERT_FLAG_READY = 0x01;    // A conversion finished
+static const uint16_t ALERT_FLAG_OVERLIMIT = 0x02; // The over-current limit tripped
+
+// --- INA219 ---
+// 32V range, /8 gain (+/-320mV), 12-bit single conversions (532us), continuous.
+// Same setup as Adafruit's setCalibration_32V_2A(); we compute current ourselves
+// so the calibration register is not needed.
+template <>
+struct PowerDriver<CHIP_INA219> {
+  static const uint16_t CONFIG = 0x399F;
+  static bool begin(const PowerChannelConfig& cfg) {
+    return ina_write_register(cfg.address, INA_REG_CONFIG, CONFIG);
+  }
+  static bool enable_ready_alert(const PowerChannelConfig&) { return false; } // No ALERT pin
+  static bool ack_alert(const PowerChannelConfig&, uint16_t& flags) { flags = ALERT_FLAG_READY; return true; }
+  static bool read(const PowerChannelConfig& cfg, uint32_t shunt_uohm, InaReading& reading) {
+    return ina219_read(cfg.address, shunt_uohm, reading);
+  }
+  static bool arm_overcurrent(const PowerChannelConfig&, int32_t, uint32_t) { return false; }
+  static bool begin_burst(const PowerChannelConfig&) { return false; }
+  static bool read_burst(const PowerChannelConfig&, uint32_t, int32_t&) { return false; }
+  static bool end_burst(const PowerChannelConfig&) { return true; }
+};
+
+// --- INA226 ---
+// 16 averages, 1.1ms bus + 1.1ms shunt, continuous shunt+bus (~35ms per result).
+template <>
+struct PowerDriver<CHIP_INA226> {
+  static const uint16_t CONFIG = 0x4527;
+  static const uint16_t MASK_CONVERSION_READY = 0x0400; // CNVR
+  static const uint16_t MASK_LATCH = 0x0001;            // LEN: hold ALERT until Mask/Enable is read
+  static const uint16_t MASK_SHUNT_OVER = 0x8000;       // SOL
+  static const uint16_t MASK_SHUNT_UNDER = 0x4000;      // SUL, for limits on negative current
+  static const uint16_t FLAG_ALERT_FUNCTION = 0x0010;   // AFF: the limit function tripped
+  static const uint16_t FLAG_CONVERSION_READY = 0x0008; // CVRF
+  // Burst: no averaging, 140us shunt conversions, shunt-only continuous (~7 kHz)
+  static const uint16_t BURST_CONFIG = 0x4005;
+
+  static bool begin(const PowerChannelConfig& cfg) {
+    return ina_write_register(cfg.address, INA_REG_CONFIG, CONFIG);
+  }
+  static bool enable_ready_alert(const PowerChannelConfig& cfg) {
+    uint16_t pending;
+    return ina_write_register(cfg.address, INA226_REG_MASK_ENABLE, MASK_CONVERSION_READY | MASK_LATCH) &&
+           ina_read_register(cfg.address, INA226_REG_MASK_ENABLE, pending); // Clear anything already latched
+  }
+  static bool ack_alert(const PowerChannelConfig& cfg, uint16_t& flags) {
+    uint16_t mask;
+    if (!ina_read_register(cfg.address, INA226_REG_MASK_ENABLE, mask)) return false;
+    flags = 0;
+    if (mask & FLAG_CONVERSION_READY) flags |= ALERT_FLAG_READY;
+    if (mask & FLAG_ALERT_FUNCTION) flags |= ALERT_FLAG_OVERLIMIT;
+    return true;
+  }
+  static bool read(const PowerChannelConfig& cfg, uint32_t shunt_uohm, InaReading& reading) {
+    return ina226_read(cfg.address, shunt_uohm, reading);
+  }
+
+  // One limit function can share ALERT with CNVR; AFF/CVRF in Mask/Enable tell them apart
+  static bool arm_overcurrent(const PowerChannelConfig& cfg, int32_t limit_ua, uint32_t shunt_uohm) {
+    uint16_t function = limit_ua < 0 ? MASK_SHUNT_UNDER : MASK_SHUNT_OVER;
+    uint16_t pending;
+    return ina_write_register(cfg.address, INA226_REG_ALERT_LIMIT, ina226_ua_to_shunt(limit_ua, shunt_uohm)) &&
+           ina_write_register(cfg.address, INA226_REG_MASK_ENABLE, function | MASK_CONVERSION_READY | MASK_LATCH) &&
+           ina_read_register(cfg.address, INA226_REG_MASK_ENABLE, pending);
+  }
+  // Alerts are masked for the burst, or CNVR would fire at 7 kHz
+  static bool begin_burst(const PowerChannelConfig& cfg) {
+    uint16_t first;
+    return ina_write_register(cfg.address, INA226_REG_MASK_ENABLE, 0) &&
+           ina_write_register(cfg.address, INA_REG_CONFIG, BURST_CONFIG) &&
+           ina_read_register(cfg.address, INA_REG_SHUNT_VOLTAGE, first); // Leaves the pointer on the shunt register
+  }
+  static bool read_burst(const PowerChannelConfig& cfg, uint32_t shunt_uohm, int32_t& current_ua) {
+    uint16_t raw;
+    if (!ina_read_pointed(cfg.address, raw)) return false;
+    current_ua = ina226_shunt_to_ua(raw, shunt_uohm);
+    return true;
+  }
+  static bool end_burst(const PowerChannelConfig& cfg) {
+    return ina_write_register(cfg.address, INA_REG_CONFIG, CONFIG); // Caller re-arms the alerts
+  }
+};
+
+// --- INA3221 ---
+// All three inputs enabled, 16 averages, 1.1ms conversions, continuous.
+// Its Warning/Critical pins are limit alerts only, so INA3221 inputs are polled.
+template <>
+struct PowerDriver<CHIP_INA3221> {
+  static const uint16_t CONFIG = 0x7527;
+  static bool begin(const PowerChannelConfig& cfg) {
+    return ina_write_register(cfg.address, INA_REG_CONFIG, CONFIG); // Harmless to repeat per input
+  }
+  static bool enable_ready_alert(const PowerChannelConfig&) { return false; }
+  static bool ack_alert(const PowerChannelConfig&, uint16_t& flags) { flags = ALERT_FLAG_READY; return true; }
+  static bool read(const PowerChannelConfig& cfg, uint32_t shunt_uohm, InaReading& reading) {
+    return ina3221_read(cfg.address, cfg.input, shunt_uohm, reading);
+  }
+  static bool arm_overcurrent(const PowerChannelConfig&, int32_t, uint32_t) { return false; }
+  static bool begin_burst(const PowerChannelConfig&) { return false; }
+  static bool read_burst(const PowerChannelConfig&, uint32_t, int32_t&) { return false; }
+  static bool end_burst(const PowerChannelConfig&) { return true; }
+};
+
+// --- Static Dispatch ---
+inline bool power_driver_begin(const PowerChannelConfig& cfg) {
+  switch (cfg.chip) {
+    case CHIP_INA219: return PowerDriver<CHIP_INA219>::begin(cfg);
+    case CHIP_INA226: return PowerDriver<CHIP_INA226>::begin(cfg);
+    case CHIP_INA3221: return PowerDriver<CHIP_INA3221>::begin(cfg);
+  }
+  return false;
+}
+
+inline bool power_driver_enable_ready_alert(const PowerChannelConfig& cfg) {
+  switch (cfg.chip) {
+    case CHIP_INA219: return PowerDriver<CHIP_INA219>::enable_ready_alert(cfg);
+    case CHIP_INA226: return PowerDriver<CHIP_INA226>::enable_ready_alert(cfg);
+    case CHIP_INA3221: return PowerDriver<CHIP_INA3221>::enable_ready_alert(cfg);
+  }
+  return false;
+}
+
+inline bool power_driver_ack_alert(const PowerChannelConfig& cfg, uint16_t& flags) {
+  switch (cfg.chip) {
+    case CHIP_INA219: return PowerDriver<CHIP_INA219>::ack_alert(cfg, flags);
+    case CHIP_INA226: return PowerDriver<CHIP_INA226>::ack_alert(cfg, flags);
+    case CHIP_INA3221: return PowerDriver<CHIP_INA3221>::ack_alert(cfg, flags);
+  }
+  return false;
+}
+
+inline bool power_driver_read(const PowerChannelConfig& cfg, uint32_t shunt_uohm, InaReading& reading) {
+  switch (cfg.chip) {
+    case CHIP_INA219: return PowerDriver<CHIP_INA219>::read(cfg, shunt_uohm, reading);
+    case CHIP_INA226: return PowerDriver<CHIP_INA226>::read(cfg, shunt_uohm, reading);
+    case CHIP_INA3221: return PowerDriver<CHIP_INA3221>::read(cfg, shunt_uohm, reading);
+  }
+  return false;
+}
+
+inline bool power_driver_arm_overcurrent(const PowerChannelConfig& cfg, int32_t limit_ua, uint32_t shunt_uohm) {
+  switch (cfg.chip) {
+    case CHIP_INA219: return PowerDriver<CHIP_INA219>::arm_overcurrent(cfg, limit_ua, shunt_uohm);
+    case CHIP_INA226: return PowerDriver<CHIP_INA226>::arm_overcurrent(cfg, limit_ua, shunt_uohm);
+    case CHIP_INA3221: return PowerDriver<CHIP_INA3221>::arm_overcurrent(cfg, limit_ua, shunt_uohm);
+  }
+  return false;
+}
+
+inline bool power_driver_begin_burst(const PowerChannelConfig& cfg) {
+  switch (cfg.chip) {
+    case CHIP_INA219: return PowerDriver<CHIP_INA219>::begin_burst(cfg);
+    case CHIP_INA226: return PowerDriver<CHIP_INA226>::begin_burst(cfg);
+    case CHIP_INA3221: return PowerDriver<CHIP_INA3221>::begin_burst(cfg);
+  }
+  return false;
+}
+
+inline bool power_driver_read_burst(const PowerChannelConfig& cfg, uint32_t shunt_uohm, int32_t& current_ua) {
+  switch (cfg.chip) {
+    case CHIP_INA219: return PowerDriver<CHIP_INA219>::read_burst(cfg, shunt_uohm, current_ua);
+    case CHIP_INA226: return PowerDriver<CHIP_INA226>::read_burst(cfg, shunt_uohm, current_ua);
+    case CHIP_INA3221: return PowerDriver<CHIP_INA3221>::read_burst(cfg, shunt_uohm, current_ua);
+  }
+  return false;
+}
+
+inline bool power_driver_end_burst(const PowerChannelConfig& cfg) {
+  switch (cfg.chip) {
+    case CHIP_INA219: return PowerDriver<CHIP_INA219>::end_burst(cfg);
+    case CHIP_INA226: return PowerDriver<CHIP_INA226>::end_burst(cfg);
+    case CHIP_INA3221: return PowerDriver<CHIP_INA3221>::end_burst(cfg);
+  }
+  return false;
+}
+
+#endif // POWER_DRIVERS_H
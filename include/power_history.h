@@ -0,0 +1,38 @@
+#ifndef POWER_HISTORY_H
+#define POWER_HISTORY_H
+
+#include <stdint.h>
+
+// --- Multi-Resolution Power History ---
+// A fixed cascade of ring buffers per power channel. Every sample updates an
+// open 1s bucket; when a bucket's period ends it is closed into its ring and
+// merged into the next level up, so each level only ever does O(1) work.
+// All storage is static, nothing is allocated after boot.
+
+enum HistoryResolution {
+  HISTORY_1S,     // Last 4 minutes (the channel screen graph draws one column per bucket)
+  HISTORY_1MIN,   // Last 60 minutes
+  HISTORY_15MIN,  // Last 24 hours
+  HISTORY_1H,     // Last 2 days
+  HISTORY_LEVELS
+};
+
+// One closed bucket
+struct PowerAggregate {
+  uint32_t start_s;    // Bucket start, seconds since boot
+  int32_t min_mw;
+  int32_t max_mw;
+  int32_t mean_mw;     // Sample mean over the bucket
+  int32_t energy_uwh;  // Net energy integrated during the bucket
+};
+
+// Feeds one sample. energy_uwh is the channel's running net energy counter.
+void power_history_add(int channel, uint32_t timestamp_us, int32_t power_mw, int64_t energy_uwh);
+
+// Number of closed buckets currently held at a resolution
+int power_history_count(int channel, HistoryResolution resolution);
+
+// Reads a closed bucket; age 0 is the most recent. Returns false if out of range.
+bool power_history_get(int channel, HistoryResolution resolution, int age, PowerAggregate& out);
+
+#endif // POWER_HISTORY_H
@@ -1,14 +1,35 @@
 #ifndef POWER_MONITOR_H
 #define POWER_MONITOR_H
 
+#include <stdint.h>
+
 void setup_power_monitor();
 void loop_power_monitor();
 
 // --- Data Getter Functions ---
-float get_bus_voltage(int channel);
-float get_shunt_voltage(int channel);
-float get_current(int channel);
-float get_power(int channel);
-bool is_sensor_online(int channel); // Checks if INA226 sensors are online
+// Channels are 1-based, in POWER_CHANNELS table order
+// Readings are fixed-point integers, exactly as the chip reported them
+int get_channel_count();
+int32_t get_bus_millivolts(int channel);
+int32_t get_current_microamps(int channel);
+int32_t get_power_milliwatts(int channel);
+bool is_sensor_online(int channel); // Checks if the channel's chip answered at boot
+float get_battery_soc();            // Battery state of charge in %, -1 until the first battery sample
+float get_battery_time_to_empty();  // Hours, 0 when not discharging
+float get_battery_time_to_full();   // Hours, 0 when not charging
+unsigned long get_samples_dropped(); // Samples lost because loop() fell too far behind
+unsigned long get_first_sample_time(); // millis() of the first reading after boot, 0 until then
+
+// Energy totals in uWh, for energy_store to save and restore
+void get_energy_totals(int channel, uint64_t& positive_uwh, uint64_t& negative_uwh);
+void restore_energy_totals(int channel, uint64_t positive_uwh, uint64_t negative_uwh);
+
+// A queued state publish never reached the broker (evicted from or dropped by
+// the outbound table): its publish filter resends it next window even inside
+// the deadband. Safe from any task; other topics are ignored.
+void power_monitor_publish_lost(const char* topic);
+
+// Prints I2C timing and sample counters (called by the diagnostics module)
+void print_power_monitor_stats();
 
 #endif
\ No newline at end of file
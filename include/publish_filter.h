@@ -0,0 +1,43 @@
+#ifndef PUBLISH_FILTER_H
+#define PUBLISH_FILTER_H
+
+#include <stdint.h>
+
+// --- Deadband / Heartbeat Publish Filter ---
+// One PublishFilter per state topic remembers the last value that actually went
+// to the broker. A new value is only sent if it moved by more than the
+// deadband, or if the topic has been silent for longer than max_silence_ms
+// (the heartbeat, so Home Assistant still sees the sensor is alive).
+
+// Thresholds for one kind of measurement. A change must exceed the larger of
+// `absolute` and `relative * |last sent value|` to be published.
+struct PublishDeadband {
+  float absolute;
+  float relative;          // 0.01 = 1%
+  uint32_t max_silence_ms; // Always publish at least this often
+};
+
+struct PublishFilter {
+  float last_value;
+  uint32_t last_sent_ms;
+  bool has_value;          // False until the first publish
+};
+
+void publish_filter_reset(PublishFilter& filter);
+
+// Returns true if `value` should be published now. The caller publishes and
+// then calls publish_filter_sent(), so a failed publish is retried next time.
+bool publish_filter_check(const PublishFilter& filter, const PublishDeadband& deadband, float value, uint32_t now_ms);
+void publish_filter_sent(PublishFilter& filter, float value, uint32_t now_ms);
+
+// The same decision without counting, for values published together: the
+// caller counts each value once, as sent or as skipped, after deciding.
+bool publish_filter_due(const PublishFilter& filter, const PublishDeadband& deadband, float value, uint32_t now_ms);
+void publish_filter_skipped();
+
+// Totals across every filter, for the diagnostics report
+unsigned long get_publish_filter_sent();
+unsigned long get_publish_filter_suppressed();
+void print_publish_filter_stats();
+
+#endif // PUBLISH_FILTER_H
@@ -0,0 +1,49 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <atomic>
+
+// --- Single-Producer / Single-Consumer Ring Buffer ---
+// Lock-free hand-off between exactly one writer task and one reader task.
+// The writer only ever moves `head`, the reader only ever moves `tail`, so
+// no locks or critical sections are needed, even across the two ESP32 cores.
+// N must be a power of two; one slot is never used to tell full from empty.
+template <typename T, size_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  // Producer side. Returns false (and drops the item) if the ring is full.
+  bool push(const T& item) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t next = (head + 1) & (N - 1);
+    if (next == _tail.load(std::memory_order_acquire)) return false;
+    _items[head] = item;
+    _head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if there is nothing to read.
+  bool pop(T& item) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return false;
+    item = _items[tail];
+    _tail.store((tail + 1) & (N - 1), std::memory_order_release);
+    return true;
+  }
+
+  // Approximate fill level; exact only when called from one of the two ends.
+  size_t size() const {
+    return (_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire)) & (N - 1);
+  }
+
+  static constexpr size_t capacity() { return N - 1; }
+
+private:
+  T _items[N];
+  std::atomic<size_t> _head{0};
+  std::atomic<size_t> _tail{0};
+};
+
+#endif // SPSC_RING_H
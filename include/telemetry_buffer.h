@@ -0,0 +1,23 @@
+#ifndef TELEMETRY_BUFFER_H
+#define TELEMETRY_BUFFER_H
+
+#include <stdint.h>
+
+// --- Store-and-Forward Telemetry Buffer ---
+// While the broker is unreachable, every publish window is recorded here
+// instead of being thrown away. Records are delta + varint encoded into a RAM
+// chunk; full chunks spill to a LittleFS file. Once MQTT is back, the backlog
+// is replayed oldest-first to MQTT_TOPIC_TELEMETRY_HISTORY at a capped rate,
+// so the live publishes keep flowing alongside it.
+
+void setup_telemetry_buffer();
+void loop_telemetry_buffer(); // Replays the backlog while connected
+
+// Records one channel's window values. timestamp_ms is millis() at the window end.
+void telemetry_buffer_add(uint8_t channel, uint32_t timestamp_ms, int32_t voltage_mv, int32_t current_ma, int32_t power_mw);
+
+// Bytes waiting to be replayed (RAM + flash)
+uint32_t telemetry_buffer_pending_bytes();
+void print_telemetry_buffer_stats();
+
+#endif // TELEMETRY_BUFFER_H
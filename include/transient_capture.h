@@ -0,0 +1,43 @@
+#ifndef TRANSIENT_CAPTURE_H
+#define TRANSIENT_CAPTURE_H
+
+#include <stdint.h>
+
+// --- Over-Current Transient Capture ---
+// INA226 channels with a capture limit also arm the chip's shunt-over-limit
+// comparator on their ALERT pin. When it trips, the sampling task burst-reads
+// that channel's shunt at ~7 kHz into a preallocated buffer, together with the
+// normal-rate samples leading up to the trigger, and hands the capture to
+// loop(), which publishes it as one message on MQTT_TOPIC_TRANSIENT_CAPTURE.
+// Only one capture is in flight; triggers while it is unpublished are counted
+// and skipped.
+
+static const int CAPTURE_PRE_SAMPLES = 32;   // ~1 s of normal-rate history
+static const int CAPTURE_POST_SAMPLES = 256; // ~36 ms at 140 us per sample
+static const uint32_t CAPTURE_SAMPLE_INTERVAL_US = 140; // Fastest INA226 shunt conversion
+
+struct TransientCapture {
+  uint8_t channel;
+  int32_t limit_ma;
+  uint32_t pre_interval_us;           // Mean spacing of the pre-trigger samples
+  uint32_t post_interval_us;          // Measured spacing of the burst samples
+  uint16_t pre_count;
+  uint16_t post_count;
+  int32_t pre_ma[CAPTURE_PRE_SAMPLES];   // Oldest first
+  int32_t post_ma[CAPTURE_POST_SAMPLES]; // From the trigger on
+};
+
+// --- Sampling task side ---
+// Feeds the pre-trigger history of a channel
+void capture_note_sample(uint8_t channel, uint32_t timestamp_us, int32_t current_ua);
+// Returns the capture buffer with the pre-trigger samples filled in, or
+// nullptr if the last capture is unpublished or we are in the holdoff.
+TransientCapture* capture_acquire(uint8_t channel, int32_t limit_ma);
+void capture_commit(); // Post samples are in, hand it to loop()
+void capture_abort();  // Burst failed, release the buffer
+
+// --- loop() side ---
+void loop_transient_capture(); // Publishes a finished capture (network task only)
+void print_transient_capture_stats();
+
+#endif // TRANSIENT_CAPTURE_H
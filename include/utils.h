@@ -5,7 +5,16 @@
 
 // --- Public Function Declarations ---
 
-const char* format_large_number(float value); // <---- ADDED
+const char* format_large_number(int32_t milliamps); // "512 mA" or "1.25 A"
+
+/**
+ * @brief Formats a fixed-point integer as a decimal string, without floats or heap.
+ * Prints value / 10^scale with `decimals` digits after the point (rounded half
+ * away from zero), followed by `unit` if given. e.g. (13215, 3, 2, "V") -> "13.22V".
+ * @return The length written, or 0 if it did not fit in `size`.
+ */
+int format_fixed(char* out, size_t size, int64_t value, int scale, int decimals,
+                 const char* unit = nullptr, bool show_sign = false);
 
 /**
  * @brief Formats a duration in milliseconds into a HH:MM:SS string.
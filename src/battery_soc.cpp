@@ -0,0 +1,128 @@
+#include <math.h>
+#include "battery_soc.h"
+
+static const float US_PER_HOUR = 3600.0e6f;
+static const float MAX_STEP_HOURS = 10.0f / 3600.0f; // Gaps longer than 10 s are not integrated
+static const float MIN_EFFICIENCY = 0.7f;
+static const float MAX_EFFICIENCY = 1.0f;
+static const float MIN_CYCLE_FRACTION = 0.2f;        // Only measure efficiency over real cycles
+
+static double clamp01(double v) {
+  return v < 0.0 ? 0.0 : (v > 1.0 ? 1.0 : v);
+}
+
+float battery_ocv_soc(const BatteryModel& model, float voltage) {
+  if (voltage <= model.ocv_volts[0]) return model.ocv_soc[0];
+  for (int i = 1; i < BATTERY_OCV_POINTS; i++) {
+    if (voltage < model.ocv_volts[i]) {
+      float span = model.ocv_volts[i] - model.ocv_volts[i - 1];
+      float frac = (voltage - model.ocv_volts[i - 1]) / span;
+      return model.ocv_soc[i - 1] + frac * (model.ocv_soc[i] - model.ocv_soc[i - 1]);
+    }
+  }
+  return model.ocv_soc[BATTERY_OCV_POINTS - 1];
+}
+
+void battery_soc_init(BatterySoc& state, const BatteryModel& model, float voltage) {
+  state.soc = clamp01(battery_ocv_soc(model, voltage));
+  state.efficiency = model.initial_efficiency;
+  state.tte_hours = 0;
+  state.ttf_hours = 0;
+  state.started = false;
+  state.last_time_us = 0;
+  state.rest_us = 0;
+  state.cycle_from_full = false;
+  state.cycle_in_mah = 0;
+  state.cycle_out_mah = 0;
+  state.trend_pending_hours = 0;
+  state.s_w = state.s_t = state.s_tt = state.s_y = state.s_ty = 0;
+}
+
+// --- Trend Regression ---
+// Sums are kept relative to the newest sample, so moving "now" forward by dt
+// only needs the shift identities below; old points fade with exp(-dt/tau).
+static void update_trend(BatterySoc& state, const BatteryModel& model, float dt_hours) {
+  float decay = expf(-dt_hours * 3600.0f / model.trend_time_constant_s);
+  float w = state.s_w, t = state.s_t;
+  state.s_tt = decay * (state.s_tt - 2 * dt_hours * t + dt_hours * dt_hours * w);
+  state.s_ty = decay * (state.s_ty - dt_hours * state.s_y);
+  state.s_t = decay * (t - dt_hours * w);
+  state.s_w = decay * w;
+  state.s_y = decay * state.s_y;
+
+  // New point at t = 0
+  state.s_w += 1;
+  state.s_y += (float)state.soc;
+
+  float denom = state.s_w * state.s_tt - state.s_t * state.s_t;
+  state.tte_hours = 0;
+  state.ttf_hours = 0;
+  if (denom <= 1e-12f) return;
+  float slope = (state.s_w * state.s_ty - state.s_t * state.s_y) / denom; // SoC per hour
+  if (slope < -1e-4f) state.tte_hours = (float)state.soc / -slope;
+  else if (slope > 1e-4f) state.ttf_hours = (1.0f - (float)state.soc) / slope;
+}
+
+// --- Full-Charge Sync ---
+static void mark_full(BatterySoc& state, const BatteryModel& model) {
+  // A whole cycle from full back to full: out/in is the real charge efficiency
+  if (state.cycle_from_full && state.cycle_out_mah > MIN_CYCLE_FRACTION * model.capacity_mah &&
+      state.cycle_in_mah > 0) {
+    float measured = state.cycle_out_mah / state.cycle_in_mah;
+    if (measured < MIN_EFFICIENCY) measured = MIN_EFFICIENCY;
+    if (measured > MAX_EFFICIENCY) measured = MAX_EFFICIENCY;
+    state.efficiency = 0.7f * state.efficiency + 0.3f * measured; // Smooth over cycles
+  }
+  state.soc = 1.0f;
+  state.cycle_from_full = true;
+  state.cycle_in_mah = 0;
+  state.cycle_out_mah = 0;
+}
+
+void battery_soc_update(BatterySoc& state, const BatteryModel& model,
+                        float voltage, float current_ma, uint32_t timestamp_us) {
+  if (!state.started) {
+    state.started = true;
+    state.last_time_us = timestamp_us;
+    return;
+  }
+  uint32_t dt_us = timestamp_us - state.last_time_us;
+  state.last_time_us = timestamp_us;
+  float dt_hours = dt_us / US_PER_HOUR;
+  if (dt_hours > MAX_STEP_HOURS) return; // Sensor gap, don't invent charge
+
+  // Coulomb counting
+  float mah = current_ma * dt_hours;
+  if (mah > 0) {
+    state.cycle_in_mah += mah;
+    state.soc += mah * state.efficiency / model.capacity_mah;
+  } else {
+    state.cycle_out_mah -= mah;
+    state.soc += mah / model.capacity_mah;
+  }
+  state.soc = clamp01(state.soc);
+
+  // OCV correction once the battery has settled
+  if (fabsf(current_ma) < model.rest_current_ma) {
+    // Stop counting once rested; only the threshold matters
+    uint64_t rest_needed_us = model.rest_time_s * 1000000ULL;
+    if (state.rest_us < rest_needed_us) state.rest_us += dt_us;
+    if (state.rest_us >= rest_needed_us) {
+      float alpha = dt_hours * 3600.0f / model.ocv_time_constant_s;
+      if (alpha > 1.0f) alpha = 1.0f;
+      state.soc += alpha * (battery_ocv_soc(model, voltage) - state.soc);
+    }
+  } else {
+    state.rest_us = 0;
+  }
+
+  if (voltage >= model.full_voltage && current_ma > 0 && current_ma < model.full_tail_current_ma) {
+    mark_full(state, model);
+  }
+
+  state.trend_pending_hours += dt_hours;
+  if (state.trend_pending_hours * 3600.0f >= BATTERY_TREND_STEP_S) {
+    update_trend(state, model, state.trend_pending_hours);
+    state.trend_pending_hours = 0;
+  }
+}
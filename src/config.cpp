@@ -1,5 +1,6 @@
 #include "config.h"
-#include <Arduino.h> // For LED_BUILTIN
+#include "publish_filter.h"
+#include "battery_soc.h"
 
 
 
@@ -9,6 +10,7 @@
 // I2C
 const int I2C_SDA_PIN = 21;
 const int I2C_SCL_PIN = 22;
+const uint32_t I2C_CLOCK_HZ = 400000; // Fast mode; both the INA219 and INA226 are rated for it
 
 // --- Rotary Encoder
 const int ENCODER_CLK_PIN = 25;
@@ -16,7 +18,6 @@ const int ENCODER_DT_PIN = 26;
 const int ENCODER_SW_PIN = 27;
 
 // INA226 Alert Pins
-const int INA_ALERT_PIN_CH1 = 35; // Solar Panel
 const int INA_ALERT_PIN_CH2 = 34; // Battery
 const int INA_ALERT_PIN_CH3 = 32; // Load
 
@@ -37,6 +38,10 @@ const int OLED_I2C_ADDRESS = 0x3C;
 // --- Wi-Fi Credentials ---
 const char* WIFI_SSID = "M&M Motors";
 const char* WIFI_PASSWORD = "seamosss";
+const unsigned long WIFI_CONNECT_TIMEOUT = 15000;
+const unsigned long WIFI_FAST_CONNECT_TIMEOUT = 3000; // A cached join normally takes well under 1s
+const unsigned long WIFI_BACKOFF_MIN = 1000;
+const unsigned long WIFI_BACKOFF_MAX = 60000;
 
 // --- MQTT Broker Settings ---
 const char* MQTT_SERVER = "192.168.0.70";
@@ -49,9 +54,9 @@ const char* DEVICE_ID = "shed_power_monitor"; // Changed from shed_solar_monitor
 const uint8_t INA226_CH1_ADDRESS = 0x40; // Solar Panel
 const uint8_t INA226_CH2_ADDRESS = 0x41; // Battery 
 const uint8_t INA226_CH3_ADDRESS = 0x44; // Load 
-const float INA226_CH1_SHUNT = 0.01;    // Shunt resistor (10 milliohms)
-const float INA226_CH2_SHUNT = 0.01;
+const float INA226_CH2_SHUNT = 0.01;    // Shunt resistor (10 milliohms)
 const float INA226_CH3_SHUNT = 0.01;
+const float INA219_CH1_SHUNT = 0.1;     // setCalibration_32V_2A() assumes the 0.1 ohm breakout shunt
 
 // --- Application Logic Constants ---
 unsigned long MOTION_TIMER_DURATION = 10000;      // 10 seconds
@@ -60,6 +65,47 @@ const int NUM_MODES = 5;
 const unsigned long INACTIVITY_TIMEOUT = 30000;
 const int DISPLAY_UPDATE_INTERVAL = 100;
 
+// --- Sample / Publish Rates ---
+const unsigned long POWER_POLL_INTERVAL = 50;    // 20 Hz for channels without an ALERT line
+const unsigned long POWER_PUBLISH_WINDOW = 5000; // Aggregate 5 s of samples per publish
+const bool ENABLE_JSON_STATE = true;              // false = legacy one-topic-per-value layout
+
+// --- Publish Filter ---
+// { absolute, relative, max silence }. Readings that wander inside the band are
+// not republished; every topic still goes out at least once every 5 minutes.
+const PublishDeadband VOLTAGE_DEADBAND = { 0.05f, 0.005f, 300000 }; // V
+const PublishDeadband CURRENT_DEADBAND = { 10.0f, 0.02f, 300000 };  // mA
+const PublishDeadband POWER_DEADBAND = { 100.0f, 0.02f, 300000 };   // mW
+const PublishDeadband ENERGY_DEADBAND = { 0.01f, 0.0f, 300000 };    // Wh
+const PublishDeadband SOC_DEADBAND = { 0.5f, 0.0f, 300000 };        // %
+
+// --- Battery State of Charge ---
+// 12 V flooded lead-acid bank; adjust capacity and the OCV curve for other batteries.
+const int BATTERY_CHANNEL = 2;
+const BatteryModel BATTERY_MODEL = {
+  20000,                                      // Capacity, mAh
+  { 11.8, 12.0, 12.2, 12.4, 12.6, 12.8 },     // Rested voltage...
+  { 0.0, 0.25, 0.5, 0.75, 0.95, 1.0 },        // ...and its SoC
+  100,                                        // Resting below 100 mA...
+  1800,                                       // ...for 30 minutes before OCV is trusted
+  600,                                        // Converge on OCV over ~10 minutes
+  14.2,                                       // Absorption voltage...
+  400,                                        // ...with under 400 mA tail current = full
+  0.85,                                       // Charge efficiency until measured
+  1800,                                       // TTE/TTF trend looks back ~30 minutes
+};
+
+// --- Energy Counter Persistence ---
+// Typically ~96 NVS writes/day (every 15 min in daylight), 1440/day worst case.
+const unsigned long ENERGY_FLUSH_INTERVAL = 900000;    // 15 minutes
+const unsigned long ENERGY_FLUSH_MIN_INTERVAL = 60000; // 1 minute
+const uint64_t ENERGY_FLUSH_DELTA_UWH = 10000000;      // 10 Wh
+const float ENERGY_FLUSH_LOW_VOLTAGE = 11.5;           // Well above the ESP32's brownout point behind the regulator
+
+// --- Diagnostics ---
+const bool ENABLE_DIAGNOSTICS = true;                   // Print performance counters to Serial
+const unsigned long DIAGNOSTICS_REPORT_INTERVAL = 60000; // Every 60 seconds
+
 // --- Grand Unified MQTT Topics ---
 // This new structure follows the home/[location]/[domain]/[object_id]/[message_type] pattern.
 
@@ -70,9 +116,8 @@ const char* MQTT_BASE_TOPIC_MANUAL_TIMER = "home/shed/number/manual_timer";
 
 // --- Device & Sensor Availability Topics ---
 const char* MQTT_TOPIC_DEVICE_AVAILABILITY = "devices/shed_power_monitor/status";
-const char* MQTT_TOPIC_PANEL_SENSOR_AVAILABILITY = "devices/shed_power_monitor/panel_sensor_status";
-const char* MQTT_TOPIC_BATTERY_SENSOR_AVAILABILITY = "devices/shed_power_monitor/battery_sensor_status";
-const char* MQTT_TOPIC_LOAD_SENSOR_AVAILABILITY = "devices/shed_power_monitor/load_sensor_status";
+// Per channel: devices/shed_power_monitor/<name>_sensor_status
+#define AVAILABILITY_TOPIC(name) "devices/shed_power_monitor/" name "_sensor_status"
 
 // --- Sensor Hub Sensor Topics (Published by Sensor Hub) ---
 const char* MQTT_TOPIC_TEMPERATURE_SHED_STATE = "home/shed/sensor/temperature/state";
@@ -93,25 +138,117 @@ const char* MQTT_TOPIC_MANUAL_TIMER_COMMAND = "home/shed/number/manual_timer/com
 const char* MQTT_TOPIC_TIMER_REMAINING_STATE = "home/shed/sensor/light_timer_remaining/state"; // NEW
 
 // --- Power Monitor Sensor Topics (Published by this device) ---
-// --- Channel 1: Solar Panel ---
-const char* MQTT_TOPIC_SOLAR_PANEL_VOLTAGE_STATE = "home/shed/sensor/solar_panel_voltage/state";
-const char* MQTT_TOPIC_SOLAR_PANEL_CURRENT_STATE = "home/shed/sensor/solar_panel_current/state";
-const char* MQTT_TOPIC_SOLAR_PANEL_POWER_STATE = "home/shed/sensor/solar_panel_power/state";
-const char* MQTT_TOPIC_SOLAR_PANEL_ENERGY_STATE = "home/shed/sensor/solar_panel_energy/state";
-
-// --- Channel 2: Battery ---
-const char* MQTT_TOPIC_BATTERY_VOLTAGE_STATE = "home/shed/sensor/solar_battery_voltage/state";
-const char* MQTT_TOPIC_BATTERY_CURRENT_STATE = "home/shed/sensor/solar_battery_current/state";
-const char* MQTT_TOPIC_BATTERY_POWER_STATE = "home/shed/sensor/solar_battery_power/state";
-const char* MQTT_TOPIC_BATTERY_ENERGY_CHARGED_STATE = "home/shed/sensor/solar_battery_energy_charged/state";
-const char* MQTT_TOPIC_BATTERY_ENERGY_DISCHARGED_STATE = "home/shed/sensor/solar_battery_energy_discharged/state";
-
-// --- Channel 3: Load ---
-const char* MQTT_TOPIC_LOAD_VOLTAGE_STATE = "home/shed/sensor/solar_load_voltage/state";
-const char* MQTT_TOPIC_LOAD_CURRENT_STATE = "home/shed/sensor/solar_load_current/state";
-const char* MQTT_TOPIC_LOAD_POWER_STATE = "home/shed/sensor/solar_load_power/state";
-const char* MQTT_TOPIC_LOAD_ENERGY_STATE = "home/shed/sensor/solar_load_energy/state";
+// Composed at compile time from each channel's slug:
+// home/shed/sensor/<slug>[_<measurement>]/<message type>
+#define SENSOR_TOPIC(slug, suffix) "home/shed/sensor/" slug suffix
+#define PANEL_SLUG "solar_panel"
+#define BATTERY_SLUG "solar_battery"
+#define LOAD_SLUG "solar_load"
+
+const char* MQTT_TOPIC_BATTERY_SOC_STATE = SENSOR_TOPIC(BATTERY_SLUG, "_soc/state");
+
+
+// --- Power Channel Table ---
+// To add a shunt, add a row here and one *_CHANNEL_SENSORS line below, then
+// bump NUM_POWER_CHANNELS and NUM_SENSORS in config.h (both are checked).
+// Capture limits must stay under the INA226's 81.92 mV shunt range: 8.1 A with 10 mOhm.
+// Channel-wide topics from the availability name and the sensor slug
+#define CHANNEL_TOPICS(avail, slug) \
+  AVAILABILITY_TOPIC(avail), SENSOR_TOPIC(slug, "_power/attributes"), SENSOR_TOPIC(slug, "/state")
+
+const PowerChannelConfig POWER_CHANNELS[] = {
+  // Channel 1: Solar Panel (INA219 has no ALERT output, so it is polled)
+  { "Solar Panel", "SOLAR", CHANNEL_SOURCE, CHIP_INA219, INA226_CH1_ADDRESS, 0, INA219_CH1_SHUNT, -1, false, 0,
+    CHANNEL_TOPICS("panel", PANEL_SLUG) },
+
+  // Channel 2: Battery
+  { "Battery", "BATTERY", CHANNEL_BATTERY, CHIP_INA226, INA226_CH2_ADDRESS, 0, INA226_CH2_SHUNT, INA_ALERT_PIN_CH2, true, -6.0,
+    CHANNEL_TOPICS("battery", BATTERY_SLUG) },
+
+  // Channel 3: Load
+  { "Load", "LOAD", CHANNEL_LOAD, CHIP_INA226, INA226_CH3_ADDRESS, 0, INA226_CH3_SHUNT, INA_ALERT_PIN_CH3, false, 6.0,
+    CHANNEL_TOPICS("load", LOAD_SLUG) },
+};
+static_assert(sizeof(POWER_CHANNELS) / sizeof(POWER_CHANNELS[0]) == NUM_POWER_CHANNELS,
+              "NUM_POWER_CHANNELS in config.h must match the POWER_CHANNELS rows");
+
+// --- Sensor Registry ---
+// Every string is a literal, so the table is constant-initialized into flash.
+// Arguments: channel index, uniq_id prefix, topic slug, object_id prefix, name prefix.
+// Fixed-point scales: V from mV, mA from uA, mW as is, Wh from uWh.
+#define VOLTAGE_SENSOR(ch, id, slug, obj, name) \
+  { ch, MEASURE_VOLTAGE, id "_voltage", obj "_voltage", name " Voltage", "mdi:flash", \
+    SENSOR_TOPIC(slug, "_voltage/state"), "v", "{{ value_json.v }}", \
+    "voltage", "V", "measurement", 3, 2, &VOLTAGE_DEADBAND, false }
+#define CURRENT_SENSOR(ch, id, slug, obj, name) \
+  { ch, MEASURE_CURRENT, id "_current", obj "_current", name " Current", "mdi:current-dc", \
+    SENSOR_TOPIC(slug, "_current/state"), "i", "{{ value_json.i }}", \
+    "current", "mA", "measurement", 3, 2, &CURRENT_DEADBAND, false }
+#define POWER_SENSOR(ch, id, slug, obj, name, icon) \
+  { ch, MEASURE_POWER, id "_power", obj "_power", name " Power", icon, \
+    SENSOR_TOPIC(slug, "_power/state"), "p", "{{ value_json.p }}", \
+    "power", "mW", "measurement", 0, 0, &POWER_DEADBAND, true }
+#define ENERGY_SENSOR(ch, id, slug, obj, name) \
+  { ch, MEASURE_ENERGY, id "_energy", obj "_energy", name " Energy", "mdi:chart-histogram", \
+    SENSOR_TOPIC(slug, "_energy/state"), "e", "{{ value_json.e }}", \
+    "energy", "Wh", "total_increasing", 6, 4, &ENERGY_DEADBAND, false }
+#define ENERGY_IN_SENSOR(ch, id, slug, obj, name) \
+  { ch, MEASURE_ENERGY_IN, id "_energy_in", obj "_energy_charged", name " Energy Charged", "mdi:battery-arrow-up", \
+    SENSOR_TOPIC(slug, "_energy_charged/state"), "e_in", "{{ value_json.e_in }}", \
+    "energy", "Wh", "total_increasing", 6, 4, &ENERGY_DEADBAND, false }
+#define ENERGY_OUT_SENSOR(ch, id, slug, obj, name) \
+  { ch, MEASURE_ENERGY_OUT, id "_energy_out", obj "_energy_discharged", name " Energy Discharged", "mdi:battery-arrow-down", \
+    SENSOR_TOPIC(slug, "_energy_discharged/state"), "e_out", "{{ value_json.e_out }}", \
+    "energy", "Wh", "total_increasing", 6, 4, &ENERGY_DEADBAND, false }
+
+// All of a channel's rows: net energy for unidirectional channels, charged
+// and discharged totals for bidirectional ones (see PowerChannelConfig)
+#define UNIDIRECTIONAL_CHANNEL_SENSORS(ch, id, slug, obj, name, icon) \
+  VOLTAGE_SENSOR(ch, id, slug, obj, name), CURRENT_SENSOR(ch, id, slug, obj, name), \
+  POWER_SENSOR(ch, id, slug, obj, name, icon), ENERGY_SENSOR(ch, id, slug, obj, name)
+#define BIDIRECTIONAL_CHANNEL_SENSORS(ch, id, slug, obj, name, icon) \
+  VOLTAGE_SENSOR(ch, id, slug, obj, name), CURRENT_SENSOR(ch, id, slug, obj, name), \
+  POWER_SENSOR(ch, id, slug, obj, name, icon), \
+  ENERGY_IN_SENSOR(ch, id, slug, obj, name), ENERGY_OUT_SENSOR(ch, id, slug, obj, name)
+
+// Unique ids, object ids and topics predate the table; keep them stable or
+// Home Assistant will create new entities and orphan the old history.
+const SensorDef SENSORS[] = {
+  UNIDIRECTIONAL_CHANNEL_SENSORS(0, "shed_solar_monitor_ch1", PANEL_SLUG, "shed_solar_panel", "Solar Panel", "mdi:solar-power-variant"),
+  BIDIRECTIONAL_CHANNEL_SENSORS(1, "shed_solar_monitor_ch2", BATTERY_SLUG, "shed_battery", "Battery", "mdi:battery"),
+  UNIDIRECTIONAL_CHANNEL_SENSORS(2, "shed_solar_monitor_ch3", LOAD_SLUG, "shed_load", "Load", "mdi:power-plug"),
+};
+static_assert(sizeof(SENSORS) / sizeof(SENSORS[0]) == NUM_SENSORS,
+              "NUM_SENSORS in config.h must match the SENSORS rows");
+
+// Battery estimates, all in the one MQTT_TOPIC_BATTERY_SOC_STATE document
+#define BATTERY_ESTIMATE(kind, id, obj, name, icon, key, device_class, unit) \
+  { kind, "shed_solar_monitor_battery_" id, obj, name, icon, key, "{{ value_json." key " }}", device_class, unit }
+
+const BatteryEstimateDef BATTERY_ESTIMATES[] = {
+  BATTERY_ESTIMATE(ESTIMATE_SOC, "soc", "shed_battery_soc", "Battery State of Charge",
+                   nullptr, "soc", "battery", "%"),
+  BATTERY_ESTIMATE(ESTIMATE_TIME_TO_EMPTY, "tte", "shed_battery_time_to_empty", "Battery Time to Empty",
+                   "mdi:battery-arrow-down", "tte_h", "duration", "h"),
+  BATTERY_ESTIMATE(ESTIMATE_TIME_TO_FULL, "ttf", "shed_battery_time_to_full", "Battery Time to Full",
+                   "mdi:battery-arrow-up", "ttf_h", "duration", "h"),
+  BATTERY_ESTIMATE(ESTIMATE_EFFICIENCY, "efficiency", "shed_battery_charge_efficiency", "Battery Charge Efficiency",
+                   "mdi:battery-sync", "eff", nullptr, "%"),
+};
+static_assert(sizeof(BATTERY_ESTIMATES) / sizeof(BATTERY_ESTIMATES[0]) == NUM_BATTERY_ESTIMATES,
+              "NUM_BATTERY_ESTIMATES in config.h must match the BATTERY_ESTIMATES rows");
+
+// --- Discovery ---
+const char* MQTT_TOPIC_DISCOVERY_HASH = "devices/shed_power_monitor/discovery_hash";
+const char* MQTT_TOPIC_HA_STATUS = "homeassistant/status";
+
+// --- Store-and-Forward Replay ---
+// Windows recorded during a broker outage are replayed here (not retained)
+const char* MQTT_TOPIC_TELEMETRY_HISTORY = "devices/shed_power_monitor/history";
 
+// --- Transient Capture ---
+// One message per over-current event (not retained)
+const char* MQTT_TOPIC_TRANSIENT_CAPTURE = "devices/shed_power_monitor/transient";
 
 // --- MQTT Payloads ---
 const char* MQTT_PAYLOAD_ONLINE = "online";
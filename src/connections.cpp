@@ -1,107 +1,462 @@
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
+#include <Preferences.h>
+#include <esp_system.h>
 #include "discovery.h"
 #include "connections.h"
 #include "config.h"
 #include "power_monitor.h"
+#include "transient_capture.h"
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <lwip/sockets.h>
 
 extern PubSubClient client;
+extern WiFiClient espClient;
 
 // main.cpp functions to handle UI updates via MQTT
+// Each gets the inbound copy of the payload (null-terminated at `length`).
 // Light state update handlers
-extern void handle_light_state_update(String message);
-extern void handle_motion_timer_state_update(String message);
-extern void handle_manual_timer_state_update(String message);
-extern void handle_timer_remaining_update(String message);
-extern void handle_occupancy_state_update(String message);
+extern void handle_light_state_update(const char* message, unsigned int length);
+extern void handle_motion_timer_state_update(const char* message, unsigned int length);
+extern void handle_manual_timer_state_update(const char* message, unsigned int length);
+extern void handle_timer_remaining_update(const char* message, unsigned int length);
+extern void handle_occupancy_state_update(const char* message, unsigned int length);
 
 // Sensor state update handlers
-extern void handle_temperature_update(String message);
-extern void handle_humidity_update(String message);
-extern void handle_pressure_update(String message);
-extern void handle_lux_update(String message);
+extern void handle_temperature_update(const char* message, unsigned int length);
+extern void handle_humidity_update(const char* message, unsigned int length);
+extern void handle_pressure_update(const char* message, unsigned int length);
+extern void handle_lux_update(const char* message, unsigned int length);
 
 extern bool is_sensor_online(int channel);
 
+// --- WiFi Connection State Machine ---
+// setup_wifi() only starts the first attempt; loop_wifi() drives it from the
+// network task, so sampling and the display run while the AP is away.
+//   WIFI_CONNECTING -> connected: cache the AP, WIFI_CONNECTED
+//                   -> timeout:   WIFI_BACKOFF (1s, 2s, 4s ... 60s, +/-25% jitter)
+//   WIFI_CONNECTED  -> link lost: WIFI_CONNECTING straight away
+//   WIFI_BACKOFF    -> wait over: WIFI_CONNECTING
+enum WifiState { WIFI_CONNECTING, WIFI_CONNECTED, WIFI_BACKOFF };
+
+// Where the last successful join went. Kept in RTC memory (survives a
+// software reset) and mirrored to NVS (survives a power cycle). With it the
+// join skips the channel scan. The address always comes from DHCP: a cached
+// lease can't be trusted once it may have expired and been handed to
+// another host, and nothing here knows how old it is after a power cycle.
+struct WifiCache {
+  uint32_t magic;
+  uint8_t bssid[6];
+  int32_t channel;
+};
+static const uint32_t WIFI_CACHE_MAGIC = 0x57494632; // "WIF2", AP only (no lease)
+RTC_DATA_ATTR WifiCache wifiCache;
+
+volatile WifiState wifiState = WIFI_CONNECTING; // Written by the network task only
+unsigned long wifiAttemptStart = 0;
+unsigned long wifiBackoff = 0;          // Current backoff step, 0 before the first failure
+unsigned long wifiBackoffUntil = 0;
+bool wifiFastAttempt = false;           // Current attempt uses the cache
+unsigned long wifiConnects = 0;
+unsigned long wifiFailures = 0;
+
+// --- Boot Timing ---
+// millis() when each milestone was first reached, 0 if it hasn't been yet
+unsigned long bootWifiTime = 0;
+unsigned long bootMqttTime = 0;
+
+static bool wifi_cache_valid() {
+  return wifiCache.magic == WIFI_CACHE_MAGIC && wifiCache.channel > 0;
+}
+
+static void load_wifi_cache() {
+  if (wifi_cache_valid()) return; // Still in RTC memory from before a soft reset
+  Preferences prefs;
+  if (prefs.begin("wifi", true)) {
+    if (prefs.getBytesLength("cache") == sizeof(WifiCache)) prefs.getBytes("cache", &wifiCache, sizeof(WifiCache));
+    prefs.end();
+  }
+  if (!wifi_cache_valid()) memset(&wifiCache, 0, sizeof(wifiCache));
+}
+
+static void save_wifi_cache() {
+  WifiCache current = {};
+  current.magic = WIFI_CACHE_MAGIC;
+  memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+  current.channel = WiFi.channel();
+  if (memcmp(&current, &wifiCache, sizeof(WifiCache)) == 0) return; // Same AP: no flash write
+
+  wifiCache = current;
+  Preferences prefs;
+  if (prefs.begin("wifi", false)) {
+    prefs.putBytes("cache", &wifiCache, sizeof(WifiCache));
+    prefs.end();
+  }
+}
+
+static void start_wifi_attempt() {
+  wifiFastAttempt = wifi_cache_valid();
+  if (wifiFastAttempt) {
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD, wifiCache.channel, wifiCache.bssid); // Skips the scan
+  } else {
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  }
+  wifiAttemptStart = millis();
+  wifiState = WIFI_CONNECTING;
+}
+
 void setup_wifi() {
-  delay(10);
   Serial.println();
   Serial.print("Connecting to ");
   Serial.println(WIFI_SSID);
 
+  WiFi.mode(WIFI_STA);
+  WiFi.persistent(false);       // We keep our own cache; don't rewrite the SDK's on every begin()
+  WiFi.setAutoReconnect(false); // loop_wifi() owns reconnecting
   WiFi.setHostname(DEVICE_ID);
 
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  load_wifi_cache();
+  start_wifi_attempt();
+}
+
+static void loop_wifi() {
+  unsigned long now = millis();
+  switch (wifiState) {
+    case WIFI_CONNECTING:
+      if (WiFi.status() == WL_CONNECTED) {
+        wifiState = WIFI_CONNECTED;
+        wifiBackoff = 0;
+        wifiConnects++;
+        if (bootWifiTime == 0) bootWifiTime = now;
+        save_wifi_cache();
+        Serial.printf("WiFi connected in %lu ms (%s), IP address: %s\n", now - wifiAttemptStart,
+                      wifiFastAttempt ? "cached AP" : "full scan", WiFi.localIP().toString().c_str());
+      } else if (now - wifiAttemptStart > (wifiFastAttempt ? WIFI_FAST_CONNECT_TIMEOUT : WIFI_CONNECT_TIMEOUT)) {
+        WiFi.disconnect();
+        wifiFailures++;
+        if (wifiFastAttempt) {
+          // The AP moved channel or went away: forget it and scan right away
+          memset(&wifiCache, 0, sizeof(wifiCache));
+          start_wifi_attempt();
+          break;
+        }
+        wifiBackoff = wifiBackoff == 0 ? WIFI_BACKOFF_MIN : wifiBackoff * 2;
+        if (wifiBackoff > WIFI_BACKOFF_MAX) wifiBackoff = WIFI_BACKOFF_MAX;
+        // +/-25% jitter so several devices behind one AP don't retry in lockstep
+        unsigned long jitter = esp_random() % (wifiBackoff / 2 + 1);
+        wifiBackoffUntil = now + wifiBackoff - wifiBackoff / 4 + jitter;
+        wifiState = WIFI_BACKOFF;
+        Serial.printf("WiFi connect failed, retrying in %lu ms\n", wifiBackoffUntil - now);
+      }
+      break;
 
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
+    case WIFI_CONNECTED:
+      if (WiFi.status() != WL_CONNECTED) {
+        Serial.println("WiFi connection lost.");
+        start_wifi_attempt();
+      }
+      break;
+
+    case WIFI_BACKOFF:
+      if ((long)(now - wifiBackoffUntil) >= 0) start_wifi_attempt();
+      break;
   }
+}
 
-  Serial.println("");
-  Serial.println("WiFi connected");
-  Serial.println("IP address: ");
-  Serial.println(WiFi.localIP());
+bool wifi_connected() {
+  return wifiState == WIFI_CONNECTED;
+}
+
+// --- Topic Routing ---
+// One row per subscribed topic. The rows point at the config.cpp constants, so
+// a topic is only ever spelled once. `quiet` topics update every few seconds
+// and are kept out of the serial log. `network_task` handlers run inside
+// mqtt_callback() instead of being queued for loop().
+struct TopicRoute {
+  const char* const* topic;
+  MqttMessageHandler handler;
+  bool quiet;
+  bool network_task;
+};
+
+static const TopicRoute TOPIC_ROUTES[] = {
+  // ---- Light Control Topics ----
+  { &MQTT_TOPIC_LIGHT_STATE,            handle_light_state_update,        false, false },
+  { &MQTT_TOPIC_MOTION_TIMER_STATE,     handle_motion_timer_state_update, false, false },
+  { &MQTT_TOPIC_MANUAL_TIMER_STATE,     handle_manual_timer_state_update, false, false },
+  { &MQTT_TOPIC_TIMER_REMAINING_STATE,  handle_timer_remaining_update,    true,  false },
+  { &MQTT_TOPIC_OCCUPANCY_STATE,        handle_occupancy_state_update,    false, false },
+  // ---- Sensor Hub Sensor Topics ----
+  { &MQTT_TOPIC_TEMPERATURE_SHED_STATE, handle_temperature_update,        true,  false },
+  { &MQTT_TOPIC_HUMIDITY_SHED_STATE,    handle_humidity_update,           true,  false },
+  { &MQTT_TOPIC_PRESSURE_SHED_STATE,    handle_pressure_update,           true,  false },
+  { &MQTT_TOPIC_LUX_SHED_STATE,         handle_lux_update,                true,  false },
+  // ---- Discovery (see discovery.h) ----
+  { &MQTT_TOPIC_DISCOVERY_HASH,         discovery_note_broker_hash,       true,  true },
+  { &MQTT_TOPIC_HA_STATUS,              discovery_note_ha_status,         false, true },
+};
+static const int NUM_TOPIC_ROUTES = sizeof(TOPIC_ROUTES) / sizeof(TOPIC_ROUTES[0]);
+
+// Open-addressed hash index over TOPIC_ROUTES: a lookup is one FNV-1a pass over
+// the incoming topic, usually one probe, and one strcmp to confirm. Slots hold
+// route index + 1 (0 = empty). Built once, the first time a message arrives.
+static const int TOPIC_INDEX_SLOTS = 32; // Power of two, well over 2x the routes
+static uint8_t topicIndex[TOPIC_INDEX_SLOTS];
+static bool topicIndexBuilt = false;
+
+static uint32_t topic_hash(const char* topic) {
+  uint32_t hash = 2166136261u;
+  while (*topic) {
+    hash ^= (uint8_t)*topic++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void build_topic_index() {
+  memset(topicIndex, 0, sizeof(topicIndex));
+  for (int i = 0; i < NUM_TOPIC_ROUTES; i++) {
+    uint32_t slot = topic_hash(*TOPIC_ROUTES[i].topic) & (TOPIC_INDEX_SLOTS - 1);
+    while (topicIndex[slot] != 0) slot = (slot + 1) & (TOPIC_INDEX_SLOTS - 1);
+    topicIndex[slot] = i + 1;
+  }
+  topicIndexBuilt = true;
+}
+
+static const TopicRoute* find_route(const char* topic) {
+  if (!topicIndexBuilt) build_topic_index();
+  uint32_t slot = topic_hash(topic) & (TOPIC_INDEX_SLOTS - 1);
+  while (topicIndex[slot] != 0) {
+    const TopicRoute& route = TOPIC_ROUTES[topicIndex[slot] - 1];
+    if (strcmp(*route.topic, topic) == 0) return &route;
+    slot = (slot + 1) & (TOPIC_INDEX_SLOTS - 1);
+  }
+  return nullptr;
+}
+
+// --- Network Task ---
+// Owns the PubSubClient and the WiFi state machine. client.connect() can sit
+// in a TCP timeout for seconds when the broker is gone; here that only stalls
+// this task. Everything else talks to it through:
+//   outbound: mqtt_publish() copies topic + payload into the outbound table (any task)
+//   inbound:  mqtt_callback() copies routed messages in, loop_mqtt() hands them to the handlers on loop()
+// Runs on core 0 below the sampling task, so a busy network never delays a reading.
+struct OutboundMessage {
+  char topic[MQTT_MAX_TOPIC_LENGTH];
+  char payload[MQTT_MAX_PAYLOAD_LENGTH];
+  uint32_t sequence;        // Enqueue order; the oldest goes first within a lane
+  bool retained;
+  bool coalesce;            // A newer value for the topic replaces this one
+  bool priority;            // Sent ahead of everything else (see PRIORITY_TOPICS)
+};
+
+struct InboundMessage {
+  uint8_t route;            // Index into TOPIC_ROUTES
+  uint8_t length;
+  char payload[MQTT_MAX_INBOUND_LENGTH];
+};
+
+static const int NETWORK_TASK_CORE = 0;
+static const int NETWORK_TASK_PRIORITY = 2; // Below the sampler (3), above idle
+static const int NETWORK_TASK_STACK = 8192; // Discovery builds a large JsonDocument
+static const int OUTBOUND_SLOTS = 16;
+static const int INBOUND_QUEUE_LENGTH = 8;
+static const TickType_t NETWORK_TASK_WAIT = pdMS_TO_TICKS(10); // Bounds client.loop() latency
+static const unsigned long MQTT_RECONNECT_INTERVAL = 5000;
+
+TaskHandle_t networkTaskHandle = nullptr;
+QueueHandle_t inboundQueue = nullptr;
+std::atomic<bool> mqttConnected{false};
+
+unsigned long outboundQueued = 0;
+unsigned long outboundSent = 0;
+unsigned long outboundCoalesced = 0;    // Overwrote a pending value for the same topic
+unsigned long outboundCoalescedBytes = 0; // Wire bytes those overwritten values would have cost
+unsigned long outboundDropped = 0;      // Table full, or evicted for a priority message
+unsigned long outboundRejected = 0;     // Too long, or broker down
+unsigned long outboundStalls = 0;       // Drain stopped on a full socket send buffer
+unsigned long outboundMaxDepth = 0;
+unsigned long inboundDropped = 0;
+
+// Wire cost of what actually reached the broker, counted after the publish
+// succeeds; values overwritten in the outbound table never get here.
+static const int MQTT_PUBLISH_OVERHEAD = 4; // Fixed header + topic length prefix, QoS 0
+unsigned long mqttPacketsSent = 0;
+unsigned long mqttBytesSent = 0;
+
+// --- Outbound Table ---
+// Holds at most one pending value per topic: publishing a topic that is
+// already waiting overwrites it, so a slow link sends the latest reading
+// instead of a backlog of stale ones. Commands the user just issued skip
+// ahead of telemetry. Replay batches opt out of coalescing (they share a topic).
+// Guarded by outboundLock; the copies inside are a few hundred bytes.
+static const char* const* PRIORITY_TOPICS[] = {
+  &MQTT_TOPIC_LIGHT_COMMAND,
+  &MQTT_TOPIC_MOTION_TIMER_COMMAND,
+  &MQTT_TOPIC_MANUAL_TIMER_COMMAND,
+};
+
+struct OutboundSlot {
+  OutboundMessage message;
+  uint32_t hash;            // topic_hash(message.topic)
+  bool used;
+};
+
+static OutboundSlot outboundSlots[OUTBOUND_SLOTS];
+static portMUX_TYPE outboundLock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t outboundSequence = 0;
+static volatile int outboundDepth = 0; // Read unlocked by drain_outbound() as a hint
+
+static bool is_priority_topic(const char* topic) {
+  for (const char* const* priority : PRIORITY_TOPICS) {
+    if (strcmp(*priority, topic) == 0) return true;
+  }
+  return false;
+}
+
+// Finds a waiting value for `topic` that may be replaced. Call with outboundLock held.
+static OutboundSlot* find_coalescable(const char* topic, uint32_t hash) {
+  for (OutboundSlot& slot : outboundSlots) {
+    if (slot.used && slot.message.coalesce && slot.hash == hash && strcmp(slot.message.topic, topic) == 0) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+// Picks a free slot; a priority message may evict the oldest telemetry,
+// whose topic is copied to `evicted` (empty otherwise). Call with outboundLock held.
+static OutboundSlot* claim_slot(bool priority, char* evicted) {
+  evicted[0] = '\0';
+  OutboundSlot* oldest = nullptr;
+  for (OutboundSlot& slot : outboundSlots) {
+    if (!slot.used) return &slot;
+    if (!slot.message.priority && (oldest == nullptr || slot.message.sequence < oldest->message.sequence)) {
+      oldest = &slot;
+    }
+  }
+  if (!priority || oldest == nullptr) return nullptr;
+  memcpy(evicted, oldest->message.topic, sizeof(oldest->message.topic));
+  oldest->used = false;
+  outboundDepth--;
+  outboundDropped++;
+  return oldest;
+}
+
+// Moves the next message to send into `out`: priority lane first, then oldest.
+static bool take_outbound(OutboundMessage& out) {
+  portENTER_CRITICAL(&outboundLock);
+  OutboundSlot* next = nullptr;
+  for (OutboundSlot& slot : outboundSlots) {
+    if (!slot.used) continue;
+    if (next == nullptr || slot.message.priority > next->message.priority ||
+        (slot.message.priority == next->message.priority && slot.message.sequence < next->message.sequence)) {
+      next = &slot;
+    }
+  }
+  if (next != nullptr) {
+    out = next->message;
+    next->used = false;
+    outboundDepth--;
+  }
+  portEXIT_CRITICAL(&outboundLock);
+  return next != nullptr;
+}
+
+// Puts back a message the client refused, in its old place in line. If a
+// newer value for the topic arrived meanwhile, the refused one is stale.
+static void requeue_outbound(const OutboundMessage& message) {
+  uint32_t hash = topic_hash(message.topic);
+  char evicted[MQTT_MAX_TOPIC_LENGTH];
+  bool dropped = false;
+  portENTER_CRITICAL(&outboundLock);
+  evicted[0] = '\0';
+  if (!message.coalesce || find_coalescable(message.topic, hash) == nullptr) {
+    OutboundSlot* slot = claim_slot(message.priority, evicted);
+    if (slot != nullptr) {
+      slot->message = message;
+      slot->hash = hash;
+      slot->used = true;
+      outboundDepth++;
+    } else {
+      outboundDropped++;
+      dropped = true;
+    }
+  }
+  portEXIT_CRITICAL(&outboundLock);
+
+  // mqtt_publish() already reported these as queued; let the filters resend them
+  if (evicted[0] != '\0') power_monitor_publish_lost(evicted);
+  if (dropped) power_monitor_publish_lost(message.topic);
+}
+
+// True when the socket's send buffer has room, so a publish won't block in
+// WiFiClient::write() waiting for the AP to drain it.
+static bool socket_writable() {
+  int fd = espClient.fd();
+  if (fd < 0) return false;
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(fd, &writeSet);
+  struct timeval timeout = { 0, 0 };
+  return select(fd + 1, nullptr, &writeSet, nullptr, &timeout) > 0;
 }
 
 void mqtt_callback(char* topic, byte* payload, unsigned int length) {
-  // Convert the payload to a printable string
-  payload[length] = '\0'; // Add a null terminator
-  String message = (char*)payload;
+  const TopicRoute* route = find_route(topic);
 
   // Add a filter to prevent spamming the serial monitor ---
-  if (String(topic) != MQTT_TOPIC_TIMER_REMAINING_STATE
-  && String(topic) != MQTT_TOPIC_LUX_SHED_STATE
-  && String(topic) != MQTT_TOPIC_TEMPERATURE_SHED_STATE
-  && String(topic) != MQTT_TOPIC_HUMIDITY_SHED_STATE
-  && String(topic) != MQTT_TOPIC_PRESSURE_SHED_STATE) {
+  if (route == nullptr || !route->quiet) {
     Serial.println("--- MQTT Message Received ---");
     Serial.print("Topic: ");
     Serial.println(topic);
     Serial.print("Payload: ");
-    Serial.println(message);
+    Serial.write(payload, length); // Not terminated: it may fill PubSubClient's buffer
+    Serial.println();
     Serial.println("-----------------------------");
   }
-  
+
   // ---- Route messages based on topic ----
-  // ---- Light Control Topics ----
-  if (String(topic) == MQTT_TOPIC_LIGHT_STATE) {
-    handle_light_state_update(message);
-  } else if (String(topic) == MQTT_TOPIC_MOTION_TIMER_STATE) {
-    handle_motion_timer_state_update(message);
-  } else if (String(topic) == MQTT_TOPIC_MANUAL_TIMER_STATE) {
-    handle_manual_timer_state_update(message);
-  } else if (String(topic) == MQTT_TOPIC_TIMER_REMAINING_STATE) {
-    handle_timer_remaining_update(message);
-  } else if (String(topic) == MQTT_TOPIC_OCCUPANCY_STATE) {
-    handle_occupancy_state_update(message); 
-  // ---- Sensor Hub Sensor Topics ----
-  } else if (String(topic) == MQTT_TOPIC_TEMPERATURE_SHED_STATE) {
-    handle_temperature_update(message);
-  } else if (String(topic) == MQTT_TOPIC_HUMIDITY_SHED_STATE) {
-    handle_humidity_update(message);
-  } else if (String(topic) == MQTT_TOPIC_PRESSURE_SHED_STATE) {
-    handle_pressure_update(message);
-  } else if (String(topic) == MQTT_TOPIC_LUX_SHED_STATE) {
-    handle_lux_update(message);
+  if (route == nullptr) return;
+  InboundMessage inbound;
+  if (length >= sizeof(inbound.payload)) {
+    inboundDropped++;
+    return;
+  }
+  inbound.route = route - TOPIC_ROUTES;
+  inbound.length = length;
+  memcpy(inbound.payload, payload, length);
+  inbound.payload[length] = '\0';
+  if (route->network_task) {
+    route->handler(inbound.payload, inbound.length);
+    return;
   }
+  // The rest touch UI state, so they run on loop() (see loop_mqtt())
+  if (xQueueSend(inboundQueue, &inbound, 0) != pdTRUE) inboundDropped++;
 }
 
 
-void reconnect() {
+static void reconnect() {
   Serial.print("Attempting MQTT connection...");
   String clientId = "ESP32-Solar-Monitor";
 
   if (client.connect(clientId.c_str(), MQTT_USER, MQTT_PASSWORD, MQTT_TOPIC_DEVICE_AVAILABILITY, 1, true, MQTT_PAYLOAD_OFFLINE)) {
     Serial.println("connected!");
+    if (bootMqttTime == 0) {
+      bootMqttTime = millis();
+      Serial.printf("Boot to MQTT online: %lu ms\n", bootMqttTime);
+    }
     Serial.println("------------------------------");
     
     // Publish device and sensor availability
     client.publish(MQTT_TOPIC_DEVICE_AVAILABILITY, MQTT_PAYLOAD_ONLINE, true);
-    client.publish(MQTT_TOPIC_PANEL_SENSOR_AVAILABILITY, is_sensor_online(1) ? MQTT_PAYLOAD_ONLINE : MQTT_PAYLOAD_OFFLINE, true);
-    client.publish(MQTT_TOPIC_BATTERY_SENSOR_AVAILABILITY, is_sensor_online(2) ? MQTT_PAYLOAD_ONLINE : MQTT_PAYLOAD_OFFLINE, true);
-    client.publish(MQTT_TOPIC_LOAD_SENSOR_AVAILABILITY, is_sensor_online(3) ? MQTT_PAYLOAD_ONLINE : MQTT_PAYLOAD_OFFLINE, true);
+    for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+      client.publish(POWER_CHANNELS[i].availability_topic, is_sensor_online(i + 1) ? MQTT_PAYLOAD_ONLINE : MQTT_PAYLOAD_OFFLINE, true);
+    }
     Serial.println("Published device and sensor availability.");
     
     // Publish the default timers (in seconds)
@@ -117,20 +472,14 @@ void reconnect() {
 
     // Subscribe to specific light topics, apply retained values if broker is online
     Serial.println("------------------------------");
-    client.subscribe(MQTT_TOPIC_LIGHT_STATE);
-    client.subscribe(MQTT_TOPIC_MOTION_TIMER_STATE);
-    client.subscribe(MQTT_TOPIC_MANUAL_TIMER_STATE);
-    client.subscribe(MQTT_TOPIC_TIMER_REMAINING_STATE);
-    client.subscribe(MQTT_TOPIC_OCCUPANCY_STATE);
-
-    // Sensor topics from Sensor Hub
-    client.subscribe(MQTT_TOPIC_TEMPERATURE_SHED_STATE);
-    client.subscribe(MQTT_TOPIC_HUMIDITY_SHED_STATE);
-    client.subscribe(MQTT_TOPIC_PRESSURE_SHED_STATE);
-    client.subscribe(MQTT_TOPIC_LUX_SHED_STATE);
+    // (light topics, sensor topics from Sensor Hub, then discovery's; see TOPIC_ROUTES)
+    for (int i = 0; i < NUM_TOPIC_ROUTES; i++) {
+      client.subscribe(*TOPIC_ROUTES[i].topic);
+    }
     Serial.println("Subscribed to command topics.");
 
-    // Publish the discovery message
+    // Discovery goes out from loop_discovery() once the broker's hash is in,
+    // and again whenever Home Assistant announces itself
     mqtt_discovery();
 
   } else {
@@ -140,3 +489,146 @@ void reconnect() {
   }
 }
 
+// Sends queued messages for as long as the socket takes them. Whatever is
+// left waits for the next pass (every NETWORK_TASK_WAIT or on the next publish).
+static void drain_outbound() {
+  OutboundMessage message;
+  while (outboundDepth > 0) {
+    if (!socket_writable()) {
+      outboundStalls++;
+      return;
+    }
+    if (!take_outbound(message)) return;
+    if (!client.publish(message.topic, message.payload, message.retained)) {
+      requeue_outbound(message); // Connection dropped mid-drain; retry after reconnect
+      return;
+    }
+    outboundSent++;
+    mqtt_count_sent(strlen(message.topic), strlen(message.payload));
+  }
+}
+
+static void network_task(void* parameter) {
+  unsigned long lastReconnectAttempt = 0;
+  bool reconnectTried = false;
+
+  for (;;) {
+    loop_wifi();
+
+    if (wifi_connected() && !client.connected()) {
+      unsigned long now = millis();
+      if (!reconnectTried || now - lastReconnectAttempt > MQTT_RECONNECT_INTERVAL) {
+        reconnectTried = true;
+        lastReconnectAttempt = now;
+        reconnect(); // Blocking, but only this task waits
+      }
+    }
+    mqttConnected.store(client.connected(), std::memory_order_release);
+
+    if (!mqttConnected.load(std::memory_order_relaxed)) {
+      // Queued messages wait for the broker; nothing else to do until then
+      vTaskDelay(NETWORK_TASK_WAIT);
+      continue;
+    }
+
+    client.loop();
+    loop_discovery();
+    loop_transient_capture(); // Streams straight into the client, so it lives here
+
+    drain_outbound();
+    // mqtt_publish() wakes us early so a new message goes out right away
+    ulTaskNotifyTake(pdTRUE, NETWORK_TASK_WAIT);
+  }
+}
+
+void setup_mqtt() {
+  client.setServer(MQTT_SERVER, 1883);
+  client.setBufferSize(MQTT_BUFFER_SIZE);
+  client.setCallback(mqtt_callback);
+  client.setSocketTimeout(5); // s; caps how long a dead broker can hold the network task
+
+  inboundQueue = xQueueCreate(INBOUND_QUEUE_LENGTH, sizeof(InboundMessage));
+  xTaskCreatePinnedToCore(network_task, "network", NETWORK_TASK_STACK, nullptr,
+                          NETWORK_TASK_PRIORITY, &networkTaskHandle, NETWORK_TASK_CORE);
+}
+
+bool mqtt_connected() {
+  return mqttConnected.load(std::memory_order_acquire);
+}
+
+bool mqtt_publish(const char* topic, const char* payload, bool retained, bool coalesce) {
+  size_t topic_length = strlen(topic);
+  size_t payload_length = strlen(payload);
+  if (!mqtt_connected() || topic_length >= MQTT_MAX_TOPIC_LENGTH || payload_length >= MQTT_MAX_PAYLOAD_LENGTH) {
+    outboundRejected++;
+    return false;
+  }
+  bool priority = is_priority_topic(topic);
+  uint32_t hash = topic_hash(topic);
+  char evicted[MQTT_MAX_TOPIC_LENGTH];
+
+  portENTER_CRITICAL(&outboundLock);
+  evicted[0] = '\0';
+  OutboundSlot* slot = coalesce ? find_coalescable(topic, hash) : nullptr;
+  if (slot != nullptr) {
+    outboundCoalesced++; // Keeps its place in line, carries the new value
+    outboundCoalescedBytes += topic_length + strlen(slot->message.payload) + MQTT_PUBLISH_OVERHEAD;
+  } else {
+    slot = claim_slot(priority, evicted);
+    if (slot != nullptr) {
+      memcpy(slot->message.topic, topic, topic_length + 1);
+      slot->message.sequence = outboundSequence++;
+      slot->message.coalesce = coalesce;
+      slot->message.priority = priority;
+      slot->hash = hash;
+      slot->used = true;
+      outboundDepth++;
+      if ((unsigned long)outboundDepth > outboundMaxDepth) outboundMaxDepth = outboundDepth;
+    } else {
+      outboundDropped++;
+    }
+  }
+  if (slot != nullptr) {
+    memcpy(slot->message.payload, payload, payload_length + 1);
+    slot->message.retained = retained;
+    outboundQueued++;
+  }
+  portEXIT_CRITICAL(&outboundLock);
+
+  // The evicted value was already reported as queued; let the filters resend it
+  if (evicted[0] != '\0') power_monitor_publish_lost(evicted);
+  if (slot == nullptr) return false;
+  if (networkTaskHandle != nullptr) xTaskNotifyGive(networkTaskHandle);
+  return true;
+}
+
+void mqtt_count_sent(size_t topic_length, size_t payload_length) {
+  mqttPacketsSent++;
+  mqttBytesSent += topic_length + payload_length + MQTT_PUBLISH_OVERHEAD;
+}
+
+void loop_mqtt() {
+  InboundMessage message;
+  while (xQueueReceive(inboundQueue, &message, 0) == pdTRUE) {
+    TOPIC_ROUTES[message.route].handler(message.payload, message.length);
+  }
+}
+
+void print_connection_stats() {
+  Serial.printf("WiFi: %s, %lu connects, %lu failed attempts\n",
+                wifi_connected() ? "connected" : "down", wifiConnects, wifiFailures);
+  Serial.printf("MQTT: %s, outbound %lu queued / %lu sent / %lu coalesced / %lu dropped / %lu rejected, "
+                "depth %d (max %lu), %lu send-buffer stalls, inbound %lu dropped\n",
+                mqtt_connected() ? "connected" : "down", outboundQueued, outboundSent, outboundCoalesced,
+                outboundDropped, outboundRejected, outboundDepth, outboundMaxDepth, outboundStalls, inboundDropped);
+  // Bytes on the wire, to compare the per-topic and JSON state modes
+  unsigned long uptime_s = millis() / 1000;
+  if (uptime_s == 0) uptime_s = 1;
+  Serial.printf("MQTT wire (%s state): %lu packets, %lu bytes, %.2f packets/s, %lu bytes/s; "
+                "coalescing saved %lu packets, %lu bytes\n",
+                ENABLE_JSON_STATE ? "JSON" : "per-topic", mqttPacketsSent, mqttBytesSent,
+                (float)mqttPacketsSent / uptime_s, mqttBytesSent / uptime_s,
+                outboundCoalesced, outboundCoalescedBytes);
+  Serial.printf("Boot timing: first sample %lu ms, WiFi %lu ms, MQTT online %lu ms\n",
+                get_first_sample_time(), bootWifiTime, bootMqttTime);
+}
@@ -0,0 +1,33 @@
+#include <Arduino.h>
+#include "diagnostics.h"
+#include "config.h"
+#include "connections.h"
+#include "power_monitor.h"
+#include "publish_filter.h"
+#include "telemetry_buffer.h"
+#include "energy_store.h"
+#include "transient_capture.h"
+#include "display_manager.h"
+
+unsigned long lastDiagnosticsReport = 0;
+uint32_t lowestMaxAllocHeap = UINT32_MAX; // Smallest largest-free-block seen: fragmentation shows up here first
+
+void loop_diagnostics() {
+  if (!ENABLE_DIAGNOSTICS) return;
+  if (millis() - lastDiagnosticsReport < DIAGNOSTICS_REPORT_INTERVAL) return;
+  lastDiagnosticsReport = millis();
+
+  Serial.println("--- Diagnostics ---");
+  uint32_t maxAlloc = ESP.getMaxAllocHeap();
+  if (maxAlloc < lowestMaxAllocHeap) lowestMaxAllocHeap = maxAlloc;
+  Serial.printf("Heap: %u free (min %u), largest block %u (lowest %u)\n",
+                ESP.getFreeHeap(), ESP.getMinFreeHeap(), maxAlloc, lowestMaxAllocHeap);
+  print_connection_stats();
+  print_power_monitor_stats();
+  print_publish_filter_stats();
+  print_telemetry_buffer_stats();
+  print_energy_store_stats();
+  print_transient_capture_stats();
+  print_display_stats();
+  Serial.println("-------------------");
+}
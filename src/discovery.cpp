@@ -1,17 +1,124 @@
 #include <ArduinoJson.h>
 #include <PubSubClient.h>
+#include <LittleFS.h>
 #include "discovery.h"
+#include "connections.h"
 #include "config.h"
 
-// This function needs access to the global MQTT client object
-extern PubSubClient client;
+// The global MQTT client object comes from connections.h
 
-void mqtt_discovery() {
+// --- JSON State Mode ---
+// With ENABLE_JSON_STATE each channel publishes one document to its state_topic,
+// so the power sensors point there and pick their field with val_tpl.
+// Window min/max ride along in the same document.
+static const char* JSON_STATE_ATTRIBUTES_TEMPLATE =
+    "{{ {'samples': value_json.n, 'p_min': value_json.p_min, 'p_max': value_json.p_max,"
+    " 'i_min': value_json.i_min, 'i_max': value_json.i_max,"
+    " 'v_min': value_json.v_min, 'v_max': value_json.v_max} | tojson }}";
 
-    // Build and publish discovery json for the device and all components
-    JsonDocument discovery_doc;
-    const char* discovery_topic = "homeassistant/device/shed_power_monitor/config"; // Unique topic for this device
+// One sensor component per SENSORS row
+static void add_sensor_components(JsonObject cmps_doc) {
+    for (const SensorDef& sensor : SENSORS) {
+        const PowerChannelConfig& cfg = POWER_CHANNELS[sensor.channel];
+        JsonObject cmp = cmps_doc[sensor.unique_id].to<JsonObject>();
+        cmp["name"] = sensor.name;
+        cmp["p"] = "sensor";
+        cmp["dev_cla"] = sensor.device_class;
+        cmp["unit_of_meas"] = sensor.unit;
+        cmp["stat_cla"] = sensor.state_class;
+        cmp["uniq_id"] = sensor.unique_id;
+        cmp["object_id"] = sensor.object_id;
+        cmp["ic"] = sensor.icon;
+        if (ENABLE_JSON_STATE) {
+            cmp["val_tpl"] = sensor.json_template;
+            cmp["stat_t"] = cfg.state_topic;
+            if (sensor.attributes) {
+                cmp["json_attr_t"] = cfg.state_topic;
+                cmp["json_attr_tpl"] = JSON_STATE_ATTRIBUTES_TEMPLATE;
+            }
+        } else {
+            cmp["val_tpl"] = "{{ value | float }}";
+            cmp["stat_t"] = sensor.state_topic;
+            if (sensor.attributes) cmp["json_attr_t"] = cfg.attributes_topic;
+        }
+        cmp["avty_t"] = cfg.availability_topic;
+        cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
+        cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+    }
+}
+
+// One sensor component per BATTERY_ESTIMATES row, all reading the SoC document
+static void add_battery_estimate_components(JsonObject cmps_doc) {
+    const char* availability = POWER_CHANNELS[BATTERY_CHANNEL - 1].availability_topic;
+    for (const BatteryEstimateDef& estimate : BATTERY_ESTIMATES) {
+        JsonObject cmp = cmps_doc[estimate.unique_id].to<JsonObject>();
+        cmp["name"] = estimate.name;
+        cmp["p"] = "sensor";
+        if (estimate.device_class) cmp["dev_cla"] = estimate.device_class;
+        cmp["unit_of_meas"] = estimate.unit;
+        cmp["stat_cla"] = "measurement";
+        cmp["val_tpl"] = estimate.json_template;
+        cmp["uniq_id"] = estimate.unique_id;
+        cmp["object_id"] = estimate.object_id;
+        if (estimate.icon) cmp["ic"] = estimate.icon;
+        cmp["stat_t"] = MQTT_TOPIC_BATTERY_SOC_STATE;
+        cmp["avty_t"] = availability;
+        cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
+        cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+    }
+}
+
+// --- Discovery Cache ---
+// The document only depends on constants, so it is built once per firmware
+// and kept in LittleFS behind a small header. Reconnects stream it from flash
+// in DISCOVERY_CHUNK pieces with beginPublish()/write(), so neither a
+// JsonDocument nor a payload-sized MQTT buffer is needed after the first boot.
+// The content hash is also published (retained) next to the config; when the
+// broker already holds ours, the ~8.5 KB publish is skipped altogether. The
+// hash can outlive the config (someone clears the config topics, or Home
+// Assistant loses them), so Home Assistant's birth message always forces a
+// republish.
+struct DiscoveryCacheHeader {
+    uint32_t magic;
+    char firmware[33];      // ESP.getSketchMD5(): a new build rebuilds the cache
+    uint32_t length;        // JSON bytes after the header
+    uint32_t hash;          // FNV-1a of those bytes
+};
+
+static const char* DISCOVERY_TOPIC = "homeassistant/device/shed_power_monitor/config"; // Unique topic for this device
+static const char* DISCOVERY_CACHE_PATH = "/discovery.json";
+static const uint32_t DISCOVERY_CACHE_MAGIC = 0x44495343; // "DISC"
+static const size_t DISCOVERY_CHUNK = 256;
+static const unsigned long DISCOVERY_HASH_WAIT = 500; // ms to wait for the retained hash after connecting
+
+// Driven by mqtt_discovery() on connect and loop_discovery() on every pass
+enum DiscoveryState { DISCOVERY_IDLE, DISCOVERY_WAIT_HASH, DISCOVERY_PUBLISH };
+
+static DiscoveryCacheHeader cacheHeader;
+static bool cacheReady = false;
+static DiscoveryState discoveryState = DISCOVERY_IDLE;
+static unsigned long connectedAt = 0;     // Starts the hash wait
+static volatile bool brokerHashSeen = false;
+static volatile uint32_t brokerHash = 0;
+static volatile bool homeAssistantRestarted = false;
+
+// Counts and hashes whatever is serialized into it
+class HashingPrint : public Print {
+public:
+    size_t count = 0;
+    uint32_t hash = 2166136261u;
+    size_t write(uint8_t c) override {
+        hash = (hash ^ c) * 16777619u;
+        count++;
+        return 1;
+    }
+    size_t write(const uint8_t* data, size_t size) override {
+        for (size_t i = 0; i < size; i++) write(data[i]);
+        return size;
+    }
+};
 
+static void build_discovery(JsonDocument& discovery_doc) {
     // Device document
     JsonObject device_doc = discovery_doc["device"].to<JsonObject>();
     device_doc["name"] = "Shed Solar Monitor";
@@ -56,235 +163,144 @@ void mqtt_discovery() {
     manual_timer_cmp["cmd_t"] = "~/command";                    // home/shed/number/manual_timer/command
     manual_timer_cmp["avty_t"] = MQTT_TOPIC_DEVICE_AVAILABILITY;       // devices/shed/solar_power_monitor/status
 
-    // INA226 Channel 1 - Solar Panel Voltage
-    JsonObject power_ch1_v_cmp = cmps_doc["shed_solar_monitor_ch1_voltage"].to<JsonObject>();
-    power_ch1_v_cmp["name"] = "Solar Panel Voltage";
-    power_ch1_v_cmp["p"] = "sensor";
-    power_ch1_v_cmp["dev_cla"] = "voltage";
-    power_ch1_v_cmp["unit_of_meas"] = "V";
-    power_ch1_v_cmp["stat_cla"] = "measurement";
-    power_ch1_v_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch1_v_cmp["uniq_id"] = "shed_solar_monitor_ch1_voltage";
-    power_ch1_v_cmp["object_id"] = "shed_solar_panel_voltage";
-    power_ch1_v_cmp["ic"] = "mdi:flash";
-    power_ch1_v_cmp["stat_t"] = MQTT_TOPIC_SOLAR_PANEL_VOLTAGE_STATE;	// home/shed/sensor/solar_panel_voltage/state
-    power_ch1_v_cmp["avty_t"] = MQTT_TOPIC_PANEL_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/panel_sensor_status
-    power_ch1_v_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch1_v_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
-
-    // INA226 Channel 1 - Solar Panel Current
-    JsonObject power_ch1_a_cmp = cmps_doc["shed_solar_monitor_ch1_current"].to<JsonObject>();
-    power_ch1_a_cmp["name"] = "Solar Panel Current";
-    power_ch1_a_cmp["p"] = "sensor";
-    power_ch1_a_cmp["dev_cla"] = "current";
-    power_ch1_a_cmp["unit_of_meas"] = "mA";
-    power_ch1_a_cmp["stat_cla"] = "measurement";
-    power_ch1_a_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch1_a_cmp["uniq_id"] = "shed_solar_monitor_ch1_current";
-    power_ch1_a_cmp["object_id"] = "shed_solar_panel_current";
-    power_ch1_a_cmp["ic"] = "mdi:current-dc";
-    power_ch1_a_cmp["stat_t"] = MQTT_TOPIC_SOLAR_PANEL_CURRENT_STATE;	// home/shed/sensor/solar_panel_current/state
-    power_ch1_a_cmp["avty_t"] = MQTT_TOPIC_PANEL_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/panel_sensor_status
-    power_ch1_a_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch1_a_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+    // Power channel sensors (voltage, current, power, energy)
+    add_sensor_components(cmps_doc);
 
-    // INA226 Channel 1 - Solar Panel Power
-    JsonObject power_ch1_p_cmp = cmps_doc["shed_solar_monitor_ch1_power"].to<JsonObject>();
-    power_ch1_p_cmp["name"] = "Solar Panel Power";
-    power_ch1_p_cmp["p"] = "sensor";
-    power_ch1_p_cmp["dev_cla"] = "power";
-    power_ch1_p_cmp["unit_of_meas"] = "mw";
-    power_ch1_p_cmp["stat_cla"] = "measurement";
-    power_ch1_p_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch1_p_cmp["uniq_id"] = "shed_solar_monitor_ch1_power";
-    power_ch1_p_cmp["object_id"] = "shed_solar_panel_power";
-    power_ch1_p_cmp["ic"] = "mdi:solar-power-variant";
-    power_ch1_p_cmp["stat_t"] = MQTT_TOPIC_SOLAR_PANEL_POWER_STATE;		// home/shed/sensor/solar_panel_power/state
-    power_ch1_p_cmp["avty_t"] = MQTT_TOPIC_PANEL_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/panel_sensor_status
-    power_ch1_p_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch1_p_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+    // Battery estimates (battery_soc estimator)
+    add_battery_estimate_components(cmps_doc);
+}
 
-    // INA226 Channel 1 - Solar Panel Total Energy
-    JsonObject power_ch1_e_cmp = cmps_doc["shed_solar_monitor_ch1_energy"].to<JsonObject>();
-    power_ch1_e_cmp["name"] = "Solar Panel Energy";
-    power_ch1_e_cmp["p"] = "sensor";
-    power_ch1_e_cmp["dev_cla"] = "energy";
-    power_ch1_e_cmp["unit_of_meas"] = "Wh";
-    power_ch1_e_cmp["stat_cla"] = "total_increasing";
-    power_ch1_e_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch1_e_cmp["uniq_id"] = "shed_solar_monitor_ch1_energy";
-    power_ch1_e_cmp["object_id"] = "shed_solar_panel_energy";
-    power_ch1_e_cmp["ic"] = "mdi:chart-histogram";
-    power_ch1_e_cmp["stat_t"] = MQTT_TOPIC_SOLAR_PANEL_ENERGY_STATE;	// home/shed/sensor/solar_panel_energy/state
-    power_ch1_e_cmp["avty_t"] = MQTT_TOPIC_PANEL_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/panel_sensor_status
-    power_ch1_e_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch1_e_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+static bool load_cache() {
+    File file = LittleFS.open(DISCOVERY_CACHE_PATH, "r");
+    if (!file) return false;
+    bool ok = file.read((uint8_t*)&cacheHeader, sizeof(cacheHeader)) == sizeof(cacheHeader) &&
+              cacheHeader.magic == DISCOVERY_CACHE_MAGIC &&
+              strcmp(cacheHeader.firmware, ESP.getSketchMD5().c_str()) == 0 &&
+              file.size() == sizeof(cacheHeader) + cacheHeader.length;
+    file.close();
+    return ok;
+}
 
-    // INA226 Channel 2 - Battery Voltage
-    JsonObject power_ch2_v_cmp = cmps_doc["shed_solar_monitor_ch2_voltage"].to<JsonObject>();
-    power_ch2_v_cmp["name"] = "Battery Voltage";
-    power_ch2_v_cmp["p"] = "sensor";
-    power_ch2_v_cmp["dev_cla"] = "voltage";
-    power_ch2_v_cmp["unit_of_meas"] = "V";
-    power_ch2_v_cmp["stat_cla"] = "measurement";
-    power_ch2_v_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch2_v_cmp["uniq_id"] = "shed_solar_monitor_ch2_voltage";
-    power_ch2_v_cmp["object_id"] = "shed_battery_voltage";
-    power_ch2_v_cmp["ic"] = "mdi:flash";
-    power_ch2_v_cmp["stat_t"] = MQTT_TOPIC_BATTERY_VOLTAGE_STATE;		// home/shed/sensor/solar_battery_voltage/state
-    power_ch2_v_cmp["avty_t"] = MQTT_TOPIC_BATTERY_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/battery_sensor_status
-    power_ch2_v_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch2_v_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+static bool write_cache() {
+    JsonDocument discovery_doc;
+    build_discovery(discovery_doc);
+    HashingPrint hasher;
+    serializeJson(discovery_doc, hasher);
 
-    // INA226 Channel 2 - Battery Current
-    JsonObject power_ch2_a_cmp = cmps_doc["shed_solar_monitor_ch2_current"].to<JsonObject>();
-    power_ch2_a_cmp["name"] = "Battery Current";
-    power_ch2_a_cmp["p"] = "sensor";
-    power_ch2_a_cmp["dev_cla"] = "current";
-    power_ch2_a_cmp["unit_of_meas"] = "mA";
-    power_ch2_a_cmp["stat_cla"] = "measurement";
-    power_ch2_a_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch2_a_cmp["uniq_id"] = "shed_solar_monitor_ch2_current";
-    power_ch2_a_cmp["object_id"] = "shed_battery_current";
-    power_ch2_a_cmp["ic"] = "mdi:current-dc";
-    power_ch2_a_cmp["stat_t"] = MQTT_TOPIC_BATTERY_CURRENT_STATE;		// home/shed/sensor/solar_battery_current/state
-    power_ch2_a_cmp["avty_t"] = MQTT_TOPIC_BATTERY_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/battery_sensor_status
-    power_ch2_a_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch2_a_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+    memset(&cacheHeader, 0, sizeof(cacheHeader));
+    cacheHeader.magic = DISCOVERY_CACHE_MAGIC;
+    strncpy(cacheHeader.firmware, ESP.getSketchMD5().c_str(), sizeof(cacheHeader.firmware) - 1);
+    cacheHeader.length = hasher.count;
+    cacheHeader.hash = hasher.hash;
 
-    // INA226 Channel 2 - Battery Power
-    JsonObject power_ch2_p_cmp = cmps_doc["shed_solar_monitor_ch2_power"].to<JsonObject>();
-    power_ch2_p_cmp["name"] = "Battery Power";
-    power_ch2_p_cmp["p"] = "sensor";
-    power_ch2_p_cmp["dev_cla"] = "power";
-    power_ch2_p_cmp["unit_of_meas"] = "mw";
-    power_ch2_p_cmp["stat_cla"] = "measurement";
-    power_ch2_p_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch2_p_cmp["uniq_id"] = "shed_solar_monitor_ch2_power";
-    power_ch2_p_cmp["object_id"] = "shed_battery_power";
-    power_ch2_p_cmp["ic"] = "mdi:battery";
-    power_ch2_p_cmp["stat_t"] = MQTT_TOPIC_BATTERY_POWER_STATE;			// home/shed/sensor/solar_battery_power/state
-    power_ch2_p_cmp["avty_t"] = MQTT_TOPIC_BATTERY_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/battery_sensor_status
-    power_ch2_p_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch2_p_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+    File file = LittleFS.open(DISCOVERY_CACHE_PATH, "w");
+    if (!file) return false;
+    bool ok = file.write((const uint8_t*)&cacheHeader, sizeof(cacheHeader)) == sizeof(cacheHeader) &&
+              serializeJson(discovery_doc, file) == hasher.count;
+    file.close();
+    if (!ok) LittleFS.remove(DISCOVERY_CACHE_PATH);
+    return ok;
+}
 
-    // INA226 Channel 2 - Battery Energy Charged
-    JsonObject power_ch2_e_in_cmp = cmps_doc["shed_solar_monitor_ch2_energy_in"].to<JsonObject>();
-    power_ch2_e_in_cmp["name"] = "Battery Energy Charged";
-    power_ch2_e_in_cmp["p"] = "sensor";
-    power_ch2_e_in_cmp["dev_cla"] = "energy";
-    power_ch2_e_in_cmp["unit_of_meas"] = "Wh";
-    power_ch2_e_in_cmp["stat_cla"] = "total_increasing";
-    power_ch2_e_in_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch2_e_in_cmp["uniq_id"] = "shed_solar_monitor_ch2_energy_in";
-    power_ch2_e_in_cmp["object_id"] = "shed_battery_energy_charged";
-    power_ch2_e_in_cmp["ic"] = "mdi:battery-arrow-up";
-    power_ch2_e_in_cmp["stat_t"] = MQTT_TOPIC_BATTERY_ENERGY_CHARGED_STATE;	// home/shed/sensor/solar_battery_energy_charged/state
-    power_ch2_e_in_cmp["avty_t"] = MQTT_TOPIC_BATTERY_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/battery_sensor_status
-    power_ch2_e_in_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch2_e_in_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+// Streams the cached document to the broker
+static bool publish_cached() {
+    File file = LittleFS.open(DISCOVERY_CACHE_PATH, "r");
+    if (!file || !file.seek(sizeof(DiscoveryCacheHeader))) return false;
+    if (!client.beginPublish(DISCOVERY_TOPIC, cacheHeader.length, true)) {
+        file.close();
+        return false;
+    }
+    bool ok = true;
+    uint8_t chunk[DISCOVERY_CHUNK];
+    size_t remaining = cacheHeader.length;
+    while (ok && remaining > 0) {
+        size_t n = file.read(chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        ok = n > 0 && client.write(chunk, n) == n;
+        remaining -= n;
+    }
+    file.close();
+    if (!client.endPublish() || !ok) return false;
+    mqtt_count_sent(strlen(DISCOVERY_TOPIC), cacheHeader.length);
+    return true;
+}
 
-    // INA226 Channel 2 - Battery Energy Discharged
-    JsonObject power_ch2_e_out_cmp = cmps_doc["shed_solar_monitor_ch2_energy_out"].to<JsonObject>();
-    power_ch2_e_out_cmp["name"] = "Battery Energy Discharged";
-    power_ch2_e_out_cmp["p"] = "sensor";
-    power_ch2_e_out_cmp["dev_cla"] = "energy";
-    power_ch2_e_out_cmp["unit_of_meas"] = "Wh";
-    power_ch2_e_out_cmp["stat_cla"] = "total_increasing";
-    power_ch2_e_out_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch2_e_out_cmp["uniq_id"] = "shed_solar_monitor_ch2_energy_out";
-    power_ch2_e_out_cmp["object_id"] = "shed_battery_energy_discharged";
-    power_ch2_e_out_cmp["ic"] = "mdi:battery-arrow-down";
-    power_ch2_e_out_cmp["stat_t"] = MQTT_TOPIC_BATTERY_ENERGY_DISCHARGED_STATE;	// home/shed/sensor/solar_battery_energy_discharged/state
-    power_ch2_e_out_cmp["avty_t"] = MQTT_TOPIC_BATTERY_SENSOR_AVAILABILITY;		// devices/shed_power_monitor/battery_sensor_status
-    power_ch2_e_out_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch2_e_out_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+// No filesystem: build the document and serialize it straight into the client
+static bool publish_direct(uint32_t& hash) {
+    JsonDocument discovery_doc;
+    build_discovery(discovery_doc);
+    HashingPrint hasher;
+    serializeJson(discovery_doc, hasher);
+    hash = hasher.hash;
+    if (!client.beginPublish(DISCOVERY_TOPIC, hasher.count, true)) return false;
+    serializeJson(discovery_doc, client);
+    if (!client.endPublish()) return false;
+    mqtt_count_sent(strlen(DISCOVERY_TOPIC), hasher.count);
+    return true;
+}
 
-    // INA226 Channel 3 - Load Voltage
-    JsonObject power_ch3_v_cmp = cmps_doc["shed_solar_monitor_ch3_voltage"].to<JsonObject>();
-    power_ch3_v_cmp["name"] = "Load Voltage";
-    power_ch3_v_cmp["p"] = "sensor";
-    power_ch3_v_cmp["dev_cla"] = "voltage";
-    power_ch3_v_cmp["unit_of_meas"] = "V";
-    power_ch3_v_cmp["stat_cla"] = "measurement";
-    power_ch3_v_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch3_v_cmp["uniq_id"] = "shed_solar_monitor_ch3_voltage";
-    power_ch3_v_cmp["object_id"] = "shed_load_voltage";
-    power_ch3_v_cmp["ic"] = "mdi:flash";
-    power_ch3_v_cmp["stat_t"] = MQTT_TOPIC_LOAD_VOLTAGE_STATE;			// home/shed/sensor/solar_load_voltage/state
-    power_ch3_v_cmp["avty_t"] = MQTT_TOPIC_LOAD_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/load_sensor_status
-    power_ch3_v_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch3_v_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+// Fed from mqtt_callback() with the retained payload of MQTT_TOPIC_DISCOVERY_HASH.
+// The topic stays subscribed, so our own hash publish echoes back here too.
+void discovery_note_broker_hash(const char* message, unsigned int length) {
+    brokerHash = strtoul(message, nullptr, 16);
+    brokerHashSeen = true;
+}
 
-    // INA226 Channel 3 - Load Current
-    JsonObject power_ch3_a_cmp = cmps_doc["shed_solar_monitor_ch3_current"].to<JsonObject>();
-    power_ch3_a_cmp["name"] = "Load Current";
-    power_ch3_a_cmp["p"] = "sensor";
-    power_ch3_a_cmp["dev_cla"] = "current";
-    power_ch3_a_cmp["unit_of_meas"] = "mA";
-    power_ch3_a_cmp["stat_cla"] = "measurement";
-    power_ch3_a_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch3_a_cmp["uniq_id"] = "shed_solar_monitor_ch3_current";
-    power_ch3_a_cmp["object_id"] = "shed_load_current";
-    power_ch3_a_cmp["ic"] = "mdi:current-dc";
-    power_ch3_a_cmp["stat_t"] = MQTT_TOPIC_LOAD_CURRENT_STATE;			// home/shed/sensor/solar_load_current/state
-    power_ch3_a_cmp["avty_t"] = MQTT_TOPIC_LOAD_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/load_sensor_status
-    power_ch3_a_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch3_a_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+// Fed from mqtt_callback() with Home Assistant's birth/will payload. A
+// retained "online" is delivered right after subscribing, within the hash
+// wait; that one is the current state, not a restart.
+void discovery_note_ha_status(const char* message, unsigned int length) {
+    if (strcmp(message, "online") != 0 || millis() - connectedAt < DISCOVERY_HASH_WAIT) return;
+    homeAssistantRestarted = true;
+}
 
-    // INA226 Channel 3 - Load Power
-    JsonObject power_ch3_p_cmp = cmps_doc["shed_solar_monitor_ch3_power"].to<JsonObject>();
-    power_ch3_p_cmp["name"] = "Load Power";
-    power_ch3_p_cmp["p"] = "sensor";
-    power_ch3_p_cmp["dev_cla"] = "power";
-    power_ch3_p_cmp["unit_of_meas"] = "mW";
-    power_ch3_p_cmp["stat_cla"] = "measurement";
-    power_ch3_p_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch3_p_cmp["uniq_id"] = "shed_solar_monitor_ch3_power";
-    power_ch3_p_cmp["object_id"] = "shed_load_power";
-    power_ch3_p_cmp["ic"] = "mdi:power-plug";
-    power_ch3_p_cmp["stat_t"] = MQTT_TOPIC_LOAD_POWER_STATE;			// home/shed/sensor/solar_load_power/state
-    power_ch3_p_cmp["avty_t"] = MQTT_TOPIC_LOAD_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/load_sensor_status
-    power_ch3_p_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch3_p_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+static void publish_discovery() {
+    uint32_t hash = cacheHeader.hash;
+    bool ok = cacheReady ? publish_cached() : publish_direct(hash);
+    if (!ok) {
+        Serial.println("Error: discovery publish failed.");
+        return;
+    }
+    char hash_payload[9];
+    snprintf(hash_payload, sizeof(hash_payload), "%08lx", (unsigned long)hash);
+    client.publish(MQTT_TOPIC_DISCOVERY_HASH, hash_payload, true);
+    Serial.println("Published discovery document.");
+}
 
-    // INA226 Channel 3 - Load Total Energy
-    JsonObject power_ch3_e_cmp = cmps_doc["shed_solar_monitor_ch3_energy"].to<JsonObject>();
-    power_ch3_e_cmp["name"] = "Load Energy";
-    power_ch3_e_cmp["p"] = "sensor";
-    power_ch3_e_cmp["dev_cla"] = "energy";
-    power_ch3_e_cmp["unit_of_meas"] = "Wh";
-    power_ch3_e_cmp["stat_cla"] = "total_increasing";
-    power_ch3_e_cmp["val_tpl"] = "{{ value | float }}";
-    power_ch3_e_cmp["uniq_id"] = "shed_solar_monitor_ch3_energy";
-    power_ch3_e_cmp["object_id"] = "shed_load_energy";
-    power_ch3_e_cmp["ic"] = "mdi:chart-histogram";
-    power_ch3_e_cmp["stat_t"] = MQTT_TOPIC_LOAD_ENERGY_STATE;			// home/shed/sensor/solar_load_energy/state
-    power_ch3_e_cmp["avty_t"] = MQTT_TOPIC_LOAD_SENSOR_AVAILABILITY;	// devices/shed_power_monitor/load_sensor_status
-    power_ch3_e_cmp["pl_avail"] = MQTT_PAYLOAD_ONLINE;
-    power_ch3_e_cmp["pl_not_avail"] = MQTT_PAYLOAD_OFFLINE;
+void mqtt_discovery() {
+    if (!cacheReady) {
+        cacheReady = load_cache() || write_cache();
+        if (cacheReady) {
+            Serial.printf("Discovery document: %lu bytes, hash %08lx\n",
+                          (unsigned long)cacheHeader.length, (unsigned long)cacheHeader.hash);
+        }
+    }
 
-    // Print the JSON document to the Serial console for debugging
-    Serial.println("--- Device Discovery Payload: ---");
-    serializeJsonPretty(discovery_doc, Serial);
-    Serial.println();
-    Serial.print("Discovery topic:");
-    Serial.println(discovery_topic);
+    // The retained hash arrives through client.loop(); loop_discovery() waits for it
+    connectedAt = millis();
+    homeAssistantRestarted = false;
+    brokerHashSeen = false;
+    discoveryState = cacheReady ? DISCOVERY_WAIT_HASH : DISCOVERY_PUBLISH;
+}
 
-    // Print the total size of the JSON document
-    size_t jsonSize = measureJson(discovery_doc);
-    Serial.println("--------------------------------");
-    Serial.print("Total JSON size: ");
-    Serial.println(jsonSize);
-    Serial.println("--------------------------------");
+void loop_discovery() {
+    if (homeAssistantRestarted) {
+        homeAssistantRestarted = false;
+        Serial.println("Home Assistant came online, republishing discovery.");
+        discoveryState = DISCOVERY_PUBLISH;
+    }
 
-    if (jsonSize < DEVICE_DISCOVERY_PAYLOAD_SIZE) {
-        Serial.println("Publishing discovery document to MQTT broker...");
-        static char buffer[DEVICE_DISCOVERY_PAYLOAD_SIZE];
-        serializeJson(discovery_doc, buffer);
-        client.publish(discovery_topic, buffer, true);
-    } else {
-        Serial.println("Error: JSON document size exceeds buffer size.");
+    if (discoveryState == DISCOVERY_WAIT_HASH) {
+        if (!brokerHashSeen && millis() - connectedAt < DISCOVERY_HASH_WAIT) return;
+        if (brokerHashSeen && brokerHash == cacheHeader.hash) {
+            Serial.println("Discovery unchanged on the broker, not republished.");
+            discoveryState = DISCOVERY_IDLE;
+            return;
+        }
+        discoveryState = DISCOVERY_PUBLISH;
     }
 
-}
\ No newline at end of file
+    if (discoveryState == DISCOVERY_PUBLISH) {
+        discoveryState = DISCOVERY_IDLE;
+        publish_discovery();
+    }
+}
@@ -3,7 +3,8 @@
 #include <SPI.h>
 #include "display_manager.h"
 #include "config.h"
-#include "utils.h" // For format_large_number
+#include "utils.h" // For format_large_number and format_fixed
+#include "power_history.h"
 
 // --- Display Object ---
 TFT_eSPI tft = TFT_eSPI();
@@ -21,6 +22,9 @@ TFT_eSPI tft = TFT_eSPI();
 #define SENSOR_THERM_COLOR 0xF800 // Red for thermometer
 #define SENSOR_CLOUD_COLOR 0x3498 // Blue for cloud
 
+// Colour of each PowerChannelRole
+static const uint16_t ROLE_COLORS[] = { SOLAR_COLOR, BATTERY_COLOR, LOAD_COLOR };
+
 // --- UI Sizing ---
 #define CONTENT_Y_START 0
 #define CONTENT_Y_END 239   // Bottom 40px are for the footer
@@ -48,15 +52,558 @@ void draw_humidity_icon(TFT_eSprite* spr, int x, int y);
 void draw_lux_icon(TFT_eSprite* spr, int x, int y);
 void draw_pressure_icon(TFT_eSprite* spr, int x, int y); 
 void draw_sun_icon(TFT_eSprite* spr, int x, int y);
-void draw_battery_icon(TFT_eSprite* spr, int x, int y, float voltage);
+int battery_fill_width(float soc, int32_t voltage_mv);
+void draw_battery_body(TFT_eSprite* spr, int x, int y);
+void draw_battery_icon(TFT_eSprite* spr, int x, int y, int fill_width);
 void draw_load_icon(TFT_eSprite* spr, int x, int y);
 
 
+// --- Retained Regions ---
+// Every band of a screen remembers the inputs it was last drawn from (the
+// formatted strings plus any icon state). A band whose inputs are unchanged
+// is neither redrawn nor pushed, so a steady screen costs almost no SPI time.
+// Switching screens invalidates everything.
+static const int NUM_REGIONS = 6;         // Bands 0-4 of the current screen, plus the footer
+static const int FOOTER_REGION = NUM_REGIONS - 1;
+static const int REGION_INPUT_BYTES = 48;
+
+// Inputs of one band, packed into a zeroed buffer so memcmp can compare them.
+// Text is stored with its terminator and handed back for drawing, so every
+// string is formatted once per frame.
+struct RegionInputs {
+  char bytes[REGION_INPUT_BYTES];
+  int len;
+  bool overflow;  // Didn't fit: treat the band as always dirty
+
+  RegionInputs() : len(0), overflow(false) { memset(bytes, 0, sizeof(bytes)); }
+
+  const char* text(const char* value) {
+    int size = strlen(value) + 1;
+    if (len + size > REGION_INPUT_BYTES) {
+      overflow = true;
+      return value;
+    }
+    memcpy(bytes + len, value, size);
+    len += size;
+    return bytes + len - size;
+  }
+
+  const char* fixed(int64_t value, int scale, int decimals, const char* unit, bool show_sign = false) {
+    char buf[20];
+    format_fixed(buf, sizeof(buf), value, scale, decimals, unit, show_sign);
+    return text(buf);
+  }
+
+  void number(int32_t value) {
+    if (len + (int)sizeof(value) > REGION_INPUT_BYTES) {
+      overflow = true;
+      return;
+    }
+    memcpy(bytes + len, &value, sizeof(value));
+    len += sizeof(value);
+  }
+};
+
+struct RetainedRegion {
+  char inputs[REGION_INPUT_BYTES];
+  bool valid;
+};
+
+static RetainedRegion retainedRegions[NUM_REGIONS];
+static DisplayMode renderedMode;
+static bool displayRendered = false;
+
+// Frame statistics (see print_display_stats())
+static unsigned long displayFrames = 0;
+static unsigned long displayBandsPushed = 0;
+static unsigned long displayBandsSkipped = 0;
+static uint64_t displayBytesPushed = 0;
+static uint32_t displayFrameBytesMax = 0;
+static uint32_t frameBytes = 0;
+static uint32_t displayCpuAvg_us = 0;   // update_display() run time, moving average
+static uint32_t displayCpuMax_us = 0;
+
+static void invalidate_regions() {
+  for (RetainedRegion& region : retainedRegions) region.valid = false;
+}
+
+// True if the band's inputs changed since it was last drawn; remembers them
+static bool region_dirty(int region, const RegionInputs& inputs) {
+  RetainedRegion& retained = retainedRegions[region];
+  if (retained.valid && memcmp(retained.inputs, inputs.bytes, REGION_INPUT_BYTES) == 0) {
+    displayBandsSkipped++;
+    return false;
+  }
+  memcpy(retained.inputs, inputs.bytes, REGION_INPUT_BYTES);
+  retained.valid = !inputs.overflow;
+  return true;
+}
+
+// --- Band Sprite Pool ---
+// Two full-width sprites, allocated once in setup_display() and shared by
+// every screen, so drawing never touches the heap. They alternate as DMA
+// buffers: while one strip goes out over SPI the CPU draws the next into
+// the other sprite, and update_display() returns with the last strip still
+// in flight. Bands taller than a pool
+// sprite are drawn in strips: each pass redraws the whole band in band
+// coordinates through a viewport shifted up to the strip, and the sprite
+// clips everything outside it.
+static const int BAND_SPRITE_HEIGHT = 80;   // Tallest overview card; 2 x 37.5 KB
+static const int NUM_BAND_SPRITES = 2;
+static TFT_eSprite bandSpriteA = TFT_eSprite(&tft);
+static TFT_eSprite bandSpriteB = TFT_eSprite(&tft);
+static TFT_eSprite* const bandSprites[NUM_BAND_SPRITES] = { &bandSpriteA, &bandSpriteB };
+static int nextBandSprite = 0;
+static bool bandPoolReady = false;
+static bool dmaEnabled = false;  // Falls back to blocking pushSprite() without DMA
+
+// Anything drawn straight to the panel must wait for the band in flight
+static void wait_band_dma() {
+  if (dmaEnabled) tft.dmaWait();
+}
+
+// Sends the top `rows` rows of a band sprite to the panel at y
+static void push_sprite_rows(TFT_eSprite* spr, int y, int rows) {
+  if (dmaEnabled) {
+    // Returns once the transfer is queued. pushImageDMA() first waits for
+    // the other sprite's transfer, so the sprite drawn next is always free.
+    tft.pushImageDMA(0, y, 240, rows, (uint16_t*)spr->getPointer());
+  } else {
+    spr->pushSprite(0, y, 0, 0, 240, rows);
+  }
+}
+
+// Usage: for (BandRenderer band(y, height); band.next(); ) { draw into band.sprite() }
+// next() pushes the strip drawn by the previous pass before starting another.
+class BandRenderer {
+public:
+  BandRenderer(int y, int height) : y_(y), height_(height), top_(-BAND_SPRITE_HEIGHT), spr_(nullptr) {}
+
+  bool next() {
+    if (spr_ != nullptr) push_strip();
+    top_ += BAND_SPRITE_HEIGHT;
+    if (!bandPoolReady || top_ >= height_) return false;
+    spr_ = bandSprites[nextBandSprite];
+    nextBandSprite = (nextBandSprite + 1) % NUM_BAND_SPRITES;
+    spr_->setViewport(0, -top_, 240, height_);
+    return true;
+  }
+
+  TFT_eSprite& sprite() { return *spr_; }
+
+private:
+  void push_strip() {
+    int rows = height_ - top_;
+    if (rows > BAND_SPRITE_HEIGHT) rows = BAND_SPRITE_HEIGHT;
+    spr_->resetViewport();
+    push_sprite_rows(spr_, y_ + top_, rows);
+    frameBytes += 240 * rows * 2; // RGB565
+    if (top_ == 0) displayBandsPushed++;
+    spr_ = nullptr;
+  }
+
+  int y_;
+  int height_;
+  int top_;       // Band row at the top of the current strip
+  TFT_eSprite* spr_;
+};
+
+// Counts direct-to-panel fills (full-screen menus)
+static void count_direct_fill(int width, int height) {
+  frameBytes += width * height * 2;
+}
+
+// --- Band Push Benchmark ---
+// Runs once at boot, before the boot message. Pushes a screen's worth of
+// bands (three 80px strips) blocking and then over DMA, and reports the CPU
+// time until the last push returns and the time until the panel has it all.
+static void draw_benchmark_band(TFT_eSprite* spr, int n) {
+  spr->fillSprite(BG_COLOR);
+  spr->fillRoundRect(5, 0, 230, 75, 10, CARD_COLOR);
+  spr->setTextDatum(TR_DATUM);
+  spr->setTextColor(TEXT_COLOR, CARD_COLOR);
+  spr->setTextSize(4);
+  spr->drawNumber(12345 + n, 220, 10);
+}
+
+static void benchmark_band_push() {
+  const int bands = 3;
+
+  uint32_t start = micros();
+  for (int n = 0; n < bands; n++) {
+    draw_benchmark_band(bandSprites[n % NUM_BAND_SPRITES], n);
+    bandSprites[n % NUM_BAND_SPRITES]->pushSprite(0, n * BAND_SPRITE_HEIGHT);
+  }
+  uint32_t sync_us = micros() - start;
+
+  uint32_t dma_cpu_us = 0, dma_total_us = 0;
+  if (dmaEnabled) {
+    start = micros();
+    for (int n = 0; n < bands; n++) {
+      draw_benchmark_band(bandSprites[n % NUM_BAND_SPRITES], n);
+      push_sprite_rows(bandSprites[n % NUM_BAND_SPRITES], n * BAND_SPRITE_HEIGHT, BAND_SPRITE_HEIGHT);
+    }
+    dma_cpu_us = micros() - start;
+    tft.dmaWait();
+    dma_total_us = micros() - start;
+  }
+
+  Serial.printf("Band push benchmark (%d x 240x%d): blocking %lu us, DMA %lu us CPU / %lu us total%s\n",
+                bands, BAND_SPRITE_HEIGHT, (unsigned long)sync_us, (unsigned long)dma_cpu_us,
+                (unsigned long)dma_total_us, dmaEnabled ? "" : " (DMA unavailable)");
+}
+
+
+// --- Icon Cache ---
+// The icon functions below are full of cos()/sin() and per-pixel plotting
+// (the pressure gauge alone is ~540 trig pairs and ~540 drawPixel calls).
+// At boot each icon state is drawn once into a scratch sprite and encoded
+// as run-length bytes over a small palette: high nibble = palette index,
+// low nibble = run length - 1, runs never cross a row. Drawing an icon is
+// then a handful of drawFastHLine() calls. Background runs are skipped, so
+// the card underneath shows through exactly as it did with live drawing.
+enum IconId {
+  ICON_SUN,
+  ICON_BATTERY_BODY,   // The fill level is one rectangle on top (draw_battery_icon())
+  ICON_LOAD,
+  ICON_TEMPERATURE,
+  ICON_HUMIDITY,
+  ICON_LUX,
+  ICON_PRESSURE,
+  ICON_LIGHT_OFF,
+  ICON_LIGHT_ON,
+  ICON_OCCUPANCY_OFF,
+  ICON_OCCUPANCY_ON,
+  NUM_ICONS
+};
+
+typedef void (*IconDrawFn)(TFT_eSprite* spr, int x, int y);
+
+static void draw_light_off_icon(TFT_eSprite* spr, int x, int y) { draw_footer_light_icon(spr, x, y, false); }
+static void draw_light_on_icon(TFT_eSprite* spr, int x, int y) { draw_footer_light_icon(spr, x, y, true); }
+static void draw_occupancy_off_icon(TFT_eSprite* spr, int x, int y) { draw_footer_occupancy_icon(spr, x, y, false); }
+static void draw_occupancy_on_icon(TFT_eSprite* spr, int x, int y) { draw_footer_occupancy_icon(spr, x, y, true); }
+
+// Bounding box of each icon relative to the (x, y) its draw function takes
+struct IconSource {
+  IconDrawFn draw;
+  int8_t left;
+  int8_t top;
+  uint8_t width;
+  uint8_t height;
+  uint16_t background;  // What the icon sits on
+};
+
+static const IconSource ICON_SOURCES[NUM_ICONS] = {
+  { draw_sun_icon,           -4, -4, 49, 49, CARD_COLOR },  // Rays reach 24px from the centre
+  { draw_battery_body,        0,  0, 60, 43, CARD_COLOR },
+  { draw_load_icon,           0,  0, 40, 40, CARD_COLOR },
+  { draw_temperature_icon,    0,  0, 44, 44, CARD_COLOR },
+  { draw_humidity_icon,       0,  0, 48, 36, CARD_COLOR },
+  { draw_lux_icon,            0,  0, 41, 41, CARD_COLOR },
+  { draw_pressure_icon,       0,  0, 40, 40, CARD_COLOR },
+  { draw_light_off_icon,      0,  0, 30, 30, BG_COLOR },
+  { draw_light_on_icon,       0,  0, 30, 30, BG_COLOR },
+  { draw_occupancy_off_icon,  0,  0, 30, 30, BG_COLOR },
+  { draw_occupancy_on_icon,   0,  0, 30, 30, BG_COLOR },
+};
+
+struct IconBitmap {
+  uint8_t* runs;        // nullptr: not cached, draw live
+  uint16_t length;
+  uint8_t colors;
+  uint16_t palette[16];
+};
+
+static IconBitmap iconCache[NUM_ICONS];
+static size_t iconCacheBytes = 0;
+
+// Encodes the icon drawn in `scratch` (box at `margin`); returns false if it
+// needs more than 16 colours or spills outside its box.
+static bool encode_icon(TFT_eSprite& scratch, int margin, const IconSource& source, IconBitmap& icon) {
+  int scratch_w = source.width + 2 * margin;
+  int scratch_h = source.height + 2 * margin;
+  icon.colors = 0;
+  icon.palette[icon.colors++] = source.background; // Index 0 is skipped when drawing
+
+  // First pass: palette and run count, and nothing drawn outside the box
+  size_t length = 0;
+  for (int y = 0; y < scratch_h; y++) {
+    int run = 0;
+    int index = -1;
+    for (int x = 0; x < scratch_w; x++) {
+      uint16_t color = scratch.readPixel(x, y);
+      bool inside = x >= margin && x < margin + source.width && y >= margin && y < margin + source.height;
+      if (!inside) {
+        if (color != source.background) return false;
+        continue;
+      }
+      int i = 0;
+      while (i < icon.colors && icon.palette[i] != color) i++;
+      if (i == icon.colors) {
+        if (icon.colors == 16) return false;
+        icon.palette[icon.colors++] = color;
+      }
+      if (i != index || run == 16) {
+        length++;
+        run = 0;
+        index = i;
+      }
+      run++;
+    }
+  }
+
+  icon.runs = (uint8_t*)malloc(length);
+  if (icon.runs == nullptr) return false;
+  icon.length = length;
+
+  // Second pass: the runs themselves
+  size_t pos = 0;
+  for (int y = margin; y < margin + source.height; y++) {
+    int run = 0;
+    int index = -1;
+    for (int x = margin; x < margin + source.width; x++) {
+      uint16_t color = scratch.readPixel(x, y);
+      int i = 0;
+      while (icon.palette[i] != color) i++;
+      if (i != index || run == 16) {
+        if (run > 0) icon.runs[pos++] = (index << 4) | (run - 1);
+        run = 0;
+        index = i;
+      }
+      run++;
+    }
+    icon.runs[pos++] = (index << 4) | (run - 1);
+  }
+  return true;
+}
+
+static void build_icon_cache() {
+  const int margin = 4; // Border checked for spill-over
+  int scratch_w = 0, scratch_h = 0;
+  for (const IconSource& source : ICON_SOURCES) {
+    if (source.width > scratch_w) scratch_w = source.width;
+    if (source.height > scratch_h) scratch_h = source.height;
+  }
+
+  TFT_eSprite scratch = TFT_eSprite(&tft);
+  scratch.setAttribute(PSRAM_ENABLE, false);
+  if (scratch.createSprite(scratch_w + 2 * margin, scratch_h + 2 * margin) == nullptr) {
+    Serial.println("Icon cache: no memory for the scratch sprite, drawing icons live");
+    return;
+  }
+  for (int id = 0; id < NUM_ICONS; id++) {
+    const IconSource& source = ICON_SOURCES[id];
+    scratch.fillSprite(source.background);
+    source.draw(&scratch, margin - source.left, margin - source.top);
+    if (encode_icon(scratch, margin, source, iconCache[id])) {
+      iconCacheBytes += iconCache[id].length;
+    } else {
+      iconCache[id].runs = nullptr;
+      Serial.printf("Icon cache: icon %d doesn't fit its box or palette, drawing it live\n", id);
+    }
+  }
+  scratch.deleteSprite();
+}
+
+// Draws an icon at the same (x, y) its draw function takes
+static void draw_icon(TFT_eSprite* spr, IconId id, int x, int y) {
+  const IconSource& source = ICON_SOURCES[id];
+  const IconBitmap& icon = iconCache[id];
+  if (icon.runs == nullptr) {
+    source.draw(spr, x, y);
+    return;
+  }
+  x += source.left;
+  y += source.top;
+  int col = 0;
+  int row = 0;
+  uint16_t i = 0;
+  while (i < icon.length) {
+    // Join consecutive runs of one colour (runs are capped at 16px)
+    uint8_t index = icon.runs[i] >> 4;
+    int length = 0;
+    do {
+      length += (icon.runs[i++] & 0x0F) + 1;
+    } while (i < icon.length && (icon.runs[i] >> 4) == index && col + length < source.width);
+    if (index != 0) spr->drawFastHLine(x + col, y + row, length, icon.palette[index]);
+    col += length;
+    if (col >= source.width) {
+      col = 0;
+      row++;
+    }
+  }
+}
+
+// Boot-time comparison for the costliest icon, in CPU cycles
+static void benchmark_icons() {
+  TFT_eSprite* spr = bandSprites[0];
+  uint32_t start = ESP.getCycleCount();
+  draw_pressure_icon(spr, 20, 20);
+  uint32_t live = ESP.getCycleCount() - start;
+  start = ESP.getCycleCount();
+  draw_icon(spr, ICON_PRESSURE, 20, 20);
+  uint32_t cached = ESP.getCycleCount() - start;
+  Serial.printf("Icon benchmark (pressure gauge, cycles): live %lu / cached %lu\n",
+                (unsigned long)live, (unsigned long)cached);
+}
+
+// --- Power Graph ---
+// The channel screens chart each channel's mean power over the last few
+// minutes, one column per closed 1 s bucket of the power history (so every
+// sample counts, not just the ones a display frame happened to see). The
+// plot is a persistent 4-bit sprite: new buckets scroll it left and only
+// their columns are drawn. It is rebuilt from the history only when the
+// screen is entered, the channel changes, or the scale moves.
+static const int GRAPH_X = 14;           // Plot position on the panel, inside the graph card
+static const int GRAPH_Y = 157;          // Below the scale label
+static const int GRAPH_WIDTH = 212;      // One column per second
+static const int GRAPH_HEIGHT = 74;
+static const int GRAPH_MIN_SCALE_MW = 100;
+
+// Palette indices of the 4-bit plot sprite
+enum GraphColor { GRAPH_BG, GRAPH_AXIS, GRAPH_SOURCE, GRAPH_BATTERY, GRAPH_LOAD, NUM_GRAPH_COLORS }; // Roles in PowerChannelRole order
+
+static TFT_eSprite graphSprite = TFT_eSprite(&tft);
+static bool graphReady = false;
+
+// What the plot sprite currently shows
+static int graphChannel = -1;
+static int32_t graphScale_mW = 0;
+static uint32_t graphNewest_s = 0;  // start_s of the rightmost column
+static bool graphHasData = false;
+
+static void setup_power_graph() {
+  graphSprite.setAttribute(PSRAM_ENABLE, false);
+  graphSprite.setColorDepth(4);
+  if (graphSprite.createSprite(GRAPH_WIDTH, GRAPH_HEIGHT) == nullptr) {
+    Serial.println("Display: no memory for the power graph");
+    return;
+  }
+  uint16_t palette[16] = { BG_COLOR, CARD_COLOR, SOLAR_COLOR, BATTERY_COLOR, LOAD_COLOR };
+  graphSprite.createPalette(palette, NUM_GRAPH_COLORS);
+  graphSprite.setScrollRect(0, 0, GRAPH_WIDTH, GRAPH_HEIGHT, GRAPH_BG);
+  graphReady = true;
+}
+
+// start_s of the newest closed 1 s bucket, false if there is none yet
+static bool graph_newest(int channel, uint32_t& newest_s) {
+  PowerAggregate bucket;
+  if (!power_history_get(channel, HISTORY_1S, 0, bucket)) return false;
+  newest_s = bucket.start_s;
+  return true;
+}
+
+// Smallest 1/2/5 x 10^n mW at or above `peak`
+static int32_t nice_scale(int32_t peak) {
+  int32_t decade = GRAPH_MIN_SCALE_MW;
+  while (true) {
+    if (peak <= decade) return decade;
+    if (peak <= 2 * decade) return 2 * decade;
+    if (peak <= 5 * decade) return 5 * decade;
+    decade *= 10;
+  }
+}
+
+// Grows as soon as a column doesn't fit; shrinks only once everything in the
+// window fits in a quarter of the scale, so it doesn't flap between steps.
+static int32_t graph_scale(int channel, int32_t current) {
+  uint32_t newest_s = 0;
+  graph_newest(channel, newest_s);
+  int32_t peak = 0;
+  PowerAggregate bucket;
+  for (int age = 0; power_history_get(channel, HISTORY_1S, age, bucket); age++) {
+    if (newest_s - bucket.start_s >= (uint32_t)GRAPH_WIDTH) break;
+    int32_t value = bucket.mean_mw < 0 ? -bucket.mean_mw : bucket.mean_mw;
+    if (value > peak) peak = value;
+  }
+  if (current == 0 || peak > current || peak < current / 4) return nice_scale(peak);
+  return current;
+}
+
+// A 0 mW column is just the zero line, which is also how missing seconds show
+static void draw_graph_column(int channel, int x, int32_t value) {
+  bool bidirectional = POWER_CHANNELS[channel].bidirectional;
+  int zero = bidirectional ? GRAPH_HEIGHT / 2 : GRAPH_HEIGHT - 1;
+  int span = bidirectional ? GRAPH_HEIGHT / 2 - 1 : GRAPH_HEIGHT - 1;
+  int y = zero - (int)((int64_t)value * span / graphScale_mW);
+  if (y < 0) y = 0;
+  if (y > GRAPH_HEIGHT - 1) y = GRAPH_HEIGHT - 1;
+
+  graphSprite.drawFastVLine(x, 0, GRAPH_HEIGHT, GRAPH_BG);
+  uint8_t color = GRAPH_SOURCE + POWER_CHANNELS[channel].role;
+  if (y < zero) graphSprite.drawFastVLine(x, y, zero - y, color);
+  else if (y > zero) graphSprite.drawFastVLine(x, zero + 1, y - zero, color);
+  graphSprite.drawPixel(x, zero, GRAPH_AXIS);
+}
+
+// Draws the buckets newer than `after_s`, each at its column relative to newest_s
+static void draw_graph_buckets(int channel, uint32_t newest_s, uint32_t after_s, bool all) {
+  PowerAggregate bucket;
+  for (int age = 0; power_history_get(channel, HISTORY_1S, age, bucket); age++) {
+    uint32_t offset = newest_s - bucket.start_s;
+    if (offset >= (uint32_t)GRAPH_WIDTH || (!all && bucket.start_s <= after_s)) break;
+    draw_graph_column(channel, GRAPH_WIDTH - 1 - offset, bucket.mean_mw);
+  }
+}
+
+// Brings the plot up to date for `channel` and pushes it if anything moved.
+// `frame_redrawn` means the graph card under it was just pushed.
+static void update_power_graph(int channel, bool frame_redrawn) {
+  uint32_t newest_s = 0;
+  bool has_data = graph_newest(channel, newest_s);
+  uint32_t shift = newest_s - graphNewest_s;
+  bool full = frame_redrawn || channel != graphChannel || has_data != graphHasData ||
+              shift >= (uint32_t)GRAPH_WIDTH;
+  if (!full && (!has_data || shift == 0)) return;
+
+  int32_t scale = graph_scale(channel, graphScale_mW);
+  if (scale != graphScale_mW) full = true;
+  graphScale_mW = scale;
+
+  if (full) {
+    graphSprite.fillSprite(GRAPH_BG);
+    for (int x = 0; x < GRAPH_WIDTH; x++) draw_graph_column(channel, x, 0);
+    if (has_data) draw_graph_buckets(channel, newest_s, 0, true);
+  } else {
+    graphSprite.scroll(-(int16_t)shift, 0);
+    for (int x = GRAPH_WIDTH - shift; x < GRAPH_WIDTH; x++) draw_graph_column(channel, x, 0);
+    draw_graph_buckets(channel, newest_s, graphNewest_s, false);
+  }
+  graphChannel = channel;
+  graphNewest_s = newest_s;
+  graphHasData = has_data;
+
+  wait_band_dma();
+  graphSprite.pushSprite(GRAPH_X, GRAPH_Y);
+  count_direct_fill(GRAPH_WIDTH, GRAPH_HEIGHT);
+}
+
 // --- Public Functions ---
 
 void setup_display() {
   tft.init();
   tft.setRotation(0);
+
+  // The band sprites live for the whole run; allocate them before the heap fragments.
+  // DMA can't read PSRAM, so keep them in internal RAM.
+  bandPoolReady = true;
+  for (TFT_eSprite* spr : bandSprites) {
+    spr->setAttribute(PSRAM_ENABLE, false);
+    if (spr->createSprite(240, BAND_SPRITE_HEIGHT) == nullptr) bandPoolReady = false;
+  }
+  if (!bandPoolReady) Serial.println("Display: band sprite allocation failed, screens disabled");
+
+  // The display is the only device on this SPI bus, so it keeps the bus for DMA
+  dmaEnabled = bandPoolReady && tft.initDMA();
+  if (dmaEnabled) tft.startWrite();
+
+  build_icon_cache();
+  setup_power_graph();
+  if (ENABLE_DIAGNOSTICS && bandPoolReady) {
+    benchmark_band_push();
+    benchmark_icons();
+  }
   
   // Draw the boot message directly to the screen
   tft.fillScreen(TFT_BLACK);
@@ -70,23 +617,20 @@ void setup_display() {
 
 // --- UPDATED: Signature back to original ---
 void update_display(DisplayMode mode, PowerSubMode powerSub, const DisplayData& data) {
-  
+  uint32_t start_us = micros();
+
+  // A new screen starts from scratch; so does the first frame after boot
+  if (!displayRendered || mode != renderedMode) {
+    invalidate_regions();
+    renderedMode = mode;
+    displayRendered = true;
+  }
+  frameBytes = 0;
+
   switch (mode) {
     case POWER_MODE_ALL:
       draw_power_overview_screen(data);
-      draw_global_footer_bar(data); // Footer updates every time
-      break;
-    case POWER_MODE_CH1:
-      draw_power_channel_screen(1, data);
-      draw_global_footer_bar(data); 
-      break;
-    case POWER_MODE_CH2:
-      draw_power_channel_screen(2, data);
-      draw_global_footer_bar(data); 
-      break;
-    case POWER_MODE_CH3:
-      draw_power_channel_screen(3, data);
-      draw_global_footer_bar(data); 
+      draw_global_footer_bar(data); // Footer is checked every time
       break;
     case SENSORS_MODE: 
       draw_sensors_screen(data);
@@ -103,178 +647,232 @@ void update_display(DisplayMode mode, PowerSubMode powerSub, const DisplayData&
       break;
       
     default:
+      if (is_power_channel_mode(mode)) { // One screen per POWER_CHANNELS row
+        draw_power_channel_screen(mode - POWER_MODE_CH1 + 1, data);
+        draw_global_footer_bar(data);
+        break;
+      }
+      wait_band_dma();
       tft.fillScreen(BG_COLOR); 
+      count_direct_fill(240, 280);
       tft.setCursor(10, 20);
       tft.setTextColor(TFT_WHITE, BG_COLOR);
       tft.setTextSize(2);
       tft.println("Screen not implemented");
       break;
   }
+
+  displayFrames++;
+  displayBytesPushed += frameBytes;
+  if (frameBytes > displayFrameBytesMax) displayFrameBytesMax = frameBytes;
+
+  // CPU time only: with DMA the last band is usually still going out
+  uint32_t cpu_us = micros() - start_us;
+  displayCpuAvg_us = displayCpuAvg_us - (displayCpuAvg_us >> 3) + (cpu_us >> 3);
+  if (cpu_us > displayCpuMax_us) displayCpuMax_us = cpu_us;
 }
 
-// --- Screen Drawing Functions ---
+void print_display_stats() {
+  Serial.printf("Display: %lu frames, %lu bands pushed / %lu unchanged, %lu KB sent (avg %lu B/frame, max %lu B)\n",
+                displayFrames, displayBandsPushed, displayBandsSkipped, (unsigned long)(displayBytesPushed / 1024),
+                displayFrames ? (unsigned long)(displayBytesPushed / displayFrames) : 0UL,
+                (unsigned long)displayFrameBytesMax);
+  Serial.printf("Display: %s push, %lu us CPU per frame (max %lu)\n", dmaEnabled ? "DMA" : "blocking",
+                (unsigned long)displayCpuAvg_us, (unsigned long)displayCpuMax_us);
+  int cached = 0;
+  for (const IconBitmap& icon : iconCache) {
+    if (icon.runs != nullptr) cached++;
+  }
+  Serial.printf("Display: %d/%d icons cached in %u bytes\n", cached, NUM_ICONS, (unsigned)iconCacheBytes);
+}
 
-// --- UPDATED: Using full-width sprites to kill ghosting & flicker ---
-void draw_power_overview_screen(const DisplayData& data) {
-  char val_buf[20]; 
+// --- Screen Drawing Functions ---
 
-  TFT_eSprite card_spr = TFT_eSprite(&tft);
-  
-  // Card dimensions
-  int card_height = 75;
+// One overview card band for a power channel. The card's layout follows the
+// channel's role: what it shows large, and which icon.
+static void draw_channel_card(int channel, int y, int band_height, int card_height, const DisplayData& data) {
+  const PowerChannelConfig& cfg = POWER_CHANNELS[channel];
   int card_width = 230;
-  int card_y_gap = 5;
-  int card_y = 5; // Start Y-pos
   int card_x = 5;
 
-  // --- 1. Solar Card Sprite (Full-width band) ---
-  // This sprite is 80px tall (5px gap + 75px card)
-  card_spr.createSprite(240, 80); 
-  card_spr.fillRect(0, 0, 240, 80, BG_COLOR); // Clear gap and bg
-  card_spr.fillRoundRect(card_x, 0, card_width, card_height, 10, CARD_COLOR); // Draw card at local Y=0
-  
-  draw_sun_icon(&card_spr, card_x + 15, 15); 
-  
-  card_spr.setTextDatum(TR_DATUM); 
-  card_spr.setTextColor(SOLAR_COLOR, CARD_COLOR);
-  card_spr.setTextSize(4);
-  sprintf(val_buf, "%.1fW", data.power[0] / 1000.0);
-  card_spr.drawString(val_buf, card_x + 215, 10); 
-  
-  card_spr.setTextSize(2);
-  card_spr.setTextColor(TEXT_COLOR, CARD_COLOR);
-  sprintf(val_buf, "%.2fV", data.busVoltage[0]);
-  card_spr.drawString(val_buf, card_x + 215, 45); 
-  sprintf(val_buf, "%s", format_large_number(data.current[0]));
-  card_spr.drawString(val_buf, card_x + 145, 45); 
-  
-  card_spr.pushSprite(0, card_y); // Push sprite to screen Y=5
-  card_spr.deleteSprite(); 
+  RegionInputs inputs;
+  const char* power = inputs.fixed(data.powerMilliwatts[channel], 3, 1, "W", cfg.bidirectional);
+  const char* voltage = inputs.fixed(data.busMillivolts[channel], 3, 2, "V");
+  const char* current = inputs.text(format_large_number(data.currentMilliamps[channel]));
+  const char* primary = current;  // Large, top right
+  const char* right = power;      // Small, bottom right
+  const char* left = voltage;     // Small, left of it
+  int battery_fill = 0;
+  switch (cfg.role) {
+    case CHANNEL_SOURCE:
+      primary = power; right = voltage; left = current;
+      break;
+    case CHANNEL_BATTERY:
+      primary = voltage; right = power; left = current;
+      // Only the battery channel has an SoC estimate; others go by voltage
+      battery_fill = battery_fill_width(channel == BATTERY_CHANNEL - 1 ? data.batterySoc : -1,
+                                        data.busMillivolts[channel]);
+      inputs.number(battery_fill);
+      break;
+    case CHANNEL_LOAD:
+      break;
+  }
+  if (!region_dirty(channel, inputs)) return;
+
+  int icon_y = (card_height - 45) / 2;  // Icons are up to 45px tall
+  int detail_y = card_height - 30;
+  for (BandRenderer band(y, band_height); band.next(); ) {
+    TFT_eSprite& card_spr = band.sprite();
+    card_spr.fillRect(0, 0, 240, band_height, BG_COLOR); // Clear gap and bg
+    card_spr.fillRoundRect(card_x, 0, card_width, card_height, 10, CARD_COLOR); // Draw card at local Y=0
+
+    switch (cfg.role) {
+      case CHANNEL_SOURCE: draw_icon(&card_spr, ICON_SUN, card_x + 15, icon_y); break;
+      case CHANNEL_BATTERY: draw_battery_icon(&card_spr, card_x + 15, icon_y, battery_fill); break;
+      case CHANNEL_LOAD: draw_icon(&card_spr, ICON_LOAD, card_x + 20, icon_y); break;
+    }
 
-  // --- 2. Battery Card Sprite (Full-width band) ---
-  card_y += card_height + card_y_gap; // New Y-pos (85)
-  // This sprite is 80px tall (5px gap + 75px card)
-  card_spr.createSprite(240, 80); 
-  card_spr.fillRect(0, 0, 240, 80, BG_COLOR); // Clear gap and bg
-  card_spr.fillRoundRect(card_x, 0, card_width, card_height, 10, CARD_COLOR); // Draw card at local Y=0
+    card_spr.setTextDatum(TR_DATUM);
+    card_spr.setTextColor(ROLE_COLORS[cfg.role], CARD_COLOR);
+    card_spr.setTextSize(4);
+    card_spr.drawString(primary, card_x + 215, 10);
 
-  draw_battery_icon(&card_spr, card_x + 15, 15, data.busVoltage[1]); 
-  
-  card_spr.setTextDatum(TR_DATUM);
-  card_spr.setTextColor(BATTERY_COLOR, CARD_COLOR);
-  card_spr.setTextSize(4);
-  sprintf(val_buf, "%.2fV", data.busVoltage[1]);
-  card_spr.drawString(val_buf, card_x + 215, 10); 
-  
-  card_spr.setTextSize(2);
-  card_spr.setTextColor(TEXT_COLOR, CARD_COLOR);
-  sprintf(val_buf, "%+.1fW", data.power[1] / 1000.0); 
-  card_spr.drawString(val_buf, card_x + 215, 45); 
-  sprintf(val_buf, "%s", format_large_number(data.current[1]));
-  card_spr.drawString(val_buf, card_x + 145, 45); 
-  
-  card_spr.pushSprite(0, card_y); // Push sprite to screen Y=85
-  card_spr.deleteSprite();
-
-  // --- 3. Load Card Sprite (Full-width band) ---
-  card_y += card_height + card_y_gap; // New Y-pos (165)
-  // This sprite is 75px tall (no bottom gap needed)
-  card_spr.createSprite(240, 75); 
-  card_spr.fillRect(0, 0, 240, 75, BG_COLOR); // Clear gap and bg
-  card_spr.fillRoundRect(card_x, 0, card_width, card_height, 10, CARD_COLOR); // Draw card at local Y=0
+    card_spr.setTextSize(2);
+    card_spr.setTextColor(TEXT_COLOR, CARD_COLOR);
+    card_spr.drawString(right, card_x + 215, detail_y);
+    card_spr.drawString(left, card_x + 145, detail_y);
+  }
+}
 
-  draw_load_icon(&card_spr, card_x + 20, 15); 
-  
-  card_spr.setTextDatum(TR_DATUM);
-  card_spr.setTextColor(LOAD_COLOR, CARD_COLOR);
-  card_spr.setTextSize(4);
-  sprintf(val_buf, "%s", format_large_number(data.current[2]));
-  card_spr.drawString(val_buf, card_x + 215, 10); 
-  
-  card_spr.setTextSize(2);
-  card_spr.setTextColor(TEXT_COLOR, CARD_COLOR);
-  sprintf(val_buf, "%.1fW", data.power[2] / 1000.0);
-  card_spr.drawString(val_buf, card_x + 215, 45); 
-  sprintf(val_buf, "%.2fV", data.busVoltage[2]);
-  card_spr.drawString(val_buf, card_x + 145, 45); 
-  
-  card_spr.pushSprite(0, card_y); // Push sprite to screen Y=165
-  card_spr.deleteSprite();
+// --- UPDATED: Using full-width sprites to kill ghosting & flicker ---
+// One card per power channel, stacked with 5px gaps; each band is its card
+// plus the gap below it, except the last, which ends at the footer.
+void draw_power_overview_screen(const DisplayData& data) {
+  static_assert(NUM_POWER_CHANNELS <= FOOTER_REGION, "One retained region per overview card");
+  int pitch = (CONTENT_Y_END + 1) / NUM_POWER_CHANNELS; // 80px with three channels
+  int card_height = pitch - 5;
+  for (int ch = 0; ch < NUM_POWER_CHANNELS; ch++) {
+    int band_height = ch == NUM_POWER_CHANNELS - 1 ? card_height : pitch;
+    draw_channel_card(ch, 5 + ch * pitch, band_height, card_height, data);
+  }
 }
 
 // --- UPDATED: Using full-width sprites to kill ghosting & flicker ---
 void draw_power_channel_screen(int channel, const DisplayData& data) {
-  char val_buf[20];
-  const char* channel_name = "";
-  uint16_t primary_color = TEXT_COLOR;
-  
-  switch (channel) {
-    case 1: channel_name = "SOLAR"; primary_color = SOLAR_COLOR; break;
-    case 2: channel_name = "BATTERY"; primary_color = BATTERY_COLOR; break;
-    case 3: channel_name = "LOAD"; primary_color = LOAD_COLOR; break;
-  }
+  const PowerChannelConfig& cfg = POWER_CHANNELS[channel - 1];
+  const char* channel_name = cfg.label;
+  uint16_t primary_color = ROLE_COLORS[cfg.role];
 
   // --- Sprite 1: Header (Full-width band) ---
-  TFT_eSprite header_spr = TFT_eSprite(&tft);
-  header_spr.createSprite(240, 40); // 40px tall for header + line
-  header_spr.fillRect(0, 0, 240, 40, BG_COLOR);
-
-  header_spr.setTextDatum(TC_DATUM); 
-  header_spr.setTextColor(primary_color, BG_COLOR);
-  header_spr.setTextSize(3); 
-  header_spr.drawString(channel_name, 120, 5);
-  header_spr.drawFastHLine(10, 35, 220, CARD_COLOR);
-
-  header_spr.pushSprite(0, 0);
-  header_spr.deleteSprite();
+  // Only depends on the channel, which is part of the screen mode
+  if (region_dirty(0, RegionInputs())) {
+    for (BandRenderer band(0, 40); band.next(); ) { // 40px tall for header + line
+      TFT_eSprite& header_spr = band.sprite();
+      header_spr.fillRect(0, 0, 240, 40, BG_COLOR);
+
+      header_spr.setTextDatum(TC_DATUM); 
+      header_spr.setTextColor(primary_color, BG_COLOR);
+      header_spr.setTextSize(3); 
+      header_spr.drawString(channel_name, 120, 5);
+      header_spr.drawFastHLine(10, 35, 220, CARD_COLOR);
+    }
+  }
   
   // --- Sprite 2: Data (V, A, W) (Full-width band) ---
-  TFT_eSprite data_spr = TFT_eSprite(&tft);
-  data_spr.createSprite(240, 100); // 100px tall
-  data_spr.fillRect(0, 0, 240, 100, BG_COLOR); 
-
-  data_spr.setTextDatum(TL_DATUM); 
-  data_spr.setTextColor(TEXT_COLOR, BG_COLOR);
-  data_spr.setTextSize(2);
-  
-  data_spr.drawString("Voltage:", 20, 0);
-  data_spr.setTextDatum(TR_DATUM); 
-  data_spr.setTextSize(3);
-  sprintf(val_buf, "%.2f V", data.busVoltage[channel - 1]);
-  data_spr.drawString(val_buf, 220, 0);
-
-  data_spr.drawString("Current:", 20, 35);
-  data_spr.setTextDatum(TR_DATUM);
-  data_spr.setTextSize(3);
-  sprintf(val_buf, "%s", format_large_number(data.current[channel - 1]));
-  data_spr.drawString(val_buf, 220, 35);
-  
-  data_spr.drawString("Power:", 20, 70);
-  data_spr.setTextDatum(TR_DATUM);
-  data_spr.setTextSize(3);
-  if (channel == 2) { 
-    sprintf(val_buf, "%+.2f W", data.power[channel - 1] / 1000.0);
-  } else {
-    sprintf(val_buf, "%.2f W", data.power[channel - 1] / 1000.0);
+  // One row per live measurement in the sensor registry; energy stays on MQTT
+  const char* labels[3];
+  const char* values[3];
+  int rows = 0;
+  RegionInputs readings;
+  for (const SensorDef& sensor : SENSORS) {
+    if (sensor.channel != channel - 1 || rows == 3) continue;
+    switch (sensor.kind) {
+      case MEASURE_VOLTAGE:
+        labels[rows] = "Voltage:";
+        values[rows] = readings.fixed(data.busMillivolts[channel - 1], 3, 2, " V");
+        break;
+      case MEASURE_CURRENT:
+        labels[rows] = "Current:";
+        values[rows] = readings.text(format_large_number(data.currentMilliamps[channel - 1]));
+        break;
+      case MEASURE_POWER:
+        labels[rows] = "Power:";
+        // Bidirectional channels show which way the power flows
+        values[rows] = readings.fixed(data.powerMilliwatts[channel - 1], 3, 2, " W", cfg.bidirectional);
+        break;
+      default:
+        continue;
+    }
+    rows++;
   }
-  data_spr.drawString(val_buf, 220, 70);
 
-  data_spr.pushSprite(0, 40); // Push at Y=40
-  data_spr.deleteSprite(); 
+  if (region_dirty(1, readings)) {
+    for (BandRenderer band(40, 100); band.next(); ) { // 100px tall
+      TFT_eSprite& data_spr = band.sprite();
+      data_spr.fillRect(0, 0, 240, 100, BG_COLOR); 
+      data_spr.setTextColor(TEXT_COLOR, BG_COLOR);
+
+      for (int row = 0; row < rows; row++) {
+        data_spr.setTextDatum(TL_DATUM);
+        data_spr.setTextSize(2);
+        data_spr.drawString(labels[row], 20, row * 35);
+        data_spr.setTextDatum(TR_DATUM);
+        data_spr.setTextSize(3);
+        data_spr.drawString(values[row], 220, row * 35);
+      }
+    }
+  }
 
   // --- Sprite 3: Graph Area (Full-width band) ---
-  TFT_eSprite graph_spr = TFT_eSprite(&tft);
-  graph_spr.createSprite(240, 100); // 100px tall
-  graph_spr.fillRect(0, 0, 240, 100, BG_COLOR);
-
-  graph_spr.drawRoundRect(10, 5, 220, 90, 5, CARD_COLOR);
-  graph_spr.setTextDatum(MC_DATUM); 
-  graph_spr.setTextSize(1);
-  graph_spr.setTextColor(SUBTLE_TEXT_COLOR, BG_COLOR);
-  graph_spr.drawString("[ Future Graph Area ]", 120, 50); 
-  
-  graph_spr.pushSprite(0, 140); // Push at Y=140
-  graph_spr.deleteSprite(); 
+  // The card and its scale label; the plot inside is its own sprite
+  int32_t scale = graphReady ? graph_scale(channel - 1, graphScale_mW) : 0;
+  RegionInputs graph;
+  const char* scale_label = graph.fixed(scale, 3, scale < 1000 ? 1 : 0, " W");
+  bool graph_redrawn = region_dirty(2, graph);
+  if (graph_redrawn) {
+    for (BandRenderer band(140, 100); band.next(); ) { // 100px tall
+      TFT_eSprite& graph_spr = band.sprite();
+      graph_spr.fillRect(0, 0, 240, 100, BG_COLOR);
+
+      graph_spr.drawRoundRect(10, 5, 220, 90, 5, CARD_COLOR);
+      graph_spr.setTextSize(1);
+      graph_spr.setTextColor(SUBTLE_TEXT_COLOR, BG_COLOR);
+      if (!graphReady) {
+        graph_spr.setTextDatum(MC_DATUM); 
+        graph_spr.drawString("[ No Graph Memory ]", 120, 50); 
+        continue;
+      }
+      graph_spr.setTextDatum(TL_DATUM);
+      graph_spr.drawString(scale_label, 16, 8);
+      char window[16];
+      snprintf(window, sizeof(window), "last %ds", GRAPH_WIDTH);
+      graph_spr.setTextDatum(TR_DATUM);
+      graph_spr.drawString(window, 224, 8);
+    }
+  }
+  if (graphReady) update_power_graph(channel - 1, graph_redrawn);
+}
+
+// One sensor card band: icon on the left, value on the right.
+// Bands are 49px tall (5px gap + 44px card); the last one adds a 4px bottom gap.
+static void draw_sensor_card(int region, int y, int height, IconId icon, int icon_y, const char* value) {
+  RegionInputs inputs;
+  value = inputs.text(value);
+  if (!region_dirty(region, inputs)) return;
+
+  int card_x = 5;
+  for (BandRenderer band(y, height); band.next(); ) {
+    TFT_eSprite& card_spr = band.sprite();
+    card_spr.fillRect(0, 0, 240, height, BG_COLOR); // Clear gap and bg
+    card_spr.fillRoundRect(card_x, 5, 230, 44, 10, CARD_COLOR); // Draw card at local Y=5
+
+    draw_icon(&card_spr, icon, card_x + 15, icon_y);
+
+    card_spr.setTextDatum(TR_DATUM); 
+    card_spr.setTextColor(SENSOR_COLOR, CARD_COLOR);
+    card_spr.setTextSize(3);
+    card_spr.drawString(value, card_x + 215, 15); // Local Y = 10 + 5
+  }
 }
 
 // --- UPDATED: Using full-width sprites to kill ghosting & flicker ---
@@ -282,162 +880,88 @@ void draw_sensors_screen(const DisplayData& data) {
   char val_buf[20];
   
   // --- Sprite 1: Header (Full-width band) ---
-  TFT_eSprite header_spr = TFT_eSprite(&tft);
-  header_spr.createSprite(240, 40); // 40px tall for header + line
-  header_spr.fillRect(0, 0, 240, 40, BG_COLOR); 
-  
-  header_spr.setTextDatum(TC_DATUM); 
-  header_spr.setTextColor(SENSOR_COLOR, BG_COLOR);
-  header_spr.setTextSize(3); 
-  header_spr.drawString("SENSORS", 120, 5);
-  header_spr.drawFastHLine(10, 35, 220, CARD_COLOR);
-
-  header_spr.pushSprite(0, 0);
-  header_spr.deleteSprite();
-
-  // Create a reusable sprite for the sensor cards
-  TFT_eSprite card_spr = TFT_eSprite(&tft);
-  int card_height = 44;
-  int card_width = 230;
-  int card_y_gap = 5; 
-  int card_y = 45; // Start Y-pos
-  int card_x = 5;
+  if (region_dirty(0, RegionInputs())) {
+    for (BandRenderer band(0, 40); band.next(); ) { // 40px tall for header + line
+      TFT_eSprite& header_spr = band.sprite();
+      header_spr.fillRect(0, 0, 240, 40, BG_COLOR); 
+    
+      header_spr.setTextDatum(TC_DATUM); 
+      header_spr.setTextColor(SENSOR_COLOR, BG_COLOR);
+      header_spr.setTextSize(3); 
+      header_spr.drawString("SENSORS", 120, 5);
+      header_spr.drawFastHLine(10, 35, 220, CARD_COLOR);
+    }
+  }
 
-  // --- 1. Temperature Card (Full-width band) ---
-  // This sprite is 49px tall (5px gap + 44px card)
-  card_spr.createSprite(240, 49);
-  card_spr.fillRect(0, 0, 240, 49, BG_COLOR); // Clear gap and bg
-  card_spr.fillRoundRect(card_x, 5, card_width, card_height, 10, CARD_COLOR); // Draw card at local Y=5
-  
-  draw_temperature_icon(&card_spr, card_x + 15, 5); // Nudged up
-  
-  card_spr.setTextDatum(TR_DATUM); 
-  card_spr.setTextColor(SENSOR_COLOR, CARD_COLOR);
-  card_spr.setTextSize(3);
+  // --- 1. Temperature Card (Y=40) ---
   sprintf(val_buf, "%.1f F", data.temperature); // Fahrenheit
-  card_spr.drawString(val_buf, card_x + 215, 15); // Local Y = 10 + 5
-  
-  card_spr.pushSprite(0, 40); // Push sprite to screen Y=40
-  card_spr.deleteSprite();
-
-  // --- 2. Humidity Card (Full-width band) ---
-  card_y = 40 + 49; // New Y-pos (89)
-  // This sprite is 49px tall (5px gap + 44px card)
-  card_spr.createSprite(240, 49);
-  card_spr.fillRect(0, 0, 240, 49, BG_COLOR); // Clear gap and bg
-  card_spr.fillRoundRect(card_x, 5, card_width, card_height, 10, CARD_COLOR); // Draw card at local Y=5
- 
-  draw_humidity_icon(&card_spr, card_x + 15, 7); // Nudged up 
-  
-  card_spr.setTextDatum(TR_DATUM); 
-  card_spr.setTextColor(SENSOR_COLOR, CARD_COLOR);
-  card_spr.setTextSize(3);
+  draw_sensor_card(1, 40, 49, ICON_TEMPERATURE, 5, val_buf); // Nudged up
+
+  // --- 2. Humidity Card (Y=89) ---
   sprintf(val_buf, "%.0f %%", data.humidity); // Percent
-  card_spr.drawString(val_buf, card_x + 215, 15); // Local Y = 10 + 5
-  
-  card_spr.pushSprite(0, card_y); // Push sprite to screen Y=89
-  card_spr.deleteSprite();
-
-  // --- 3. Lux Card (Full-width band) ---
-  card_y += 49; // New Y-pos (138)
-  card_spr.createSprite(240, 49);
-  card_spr.fillRect(0, 0, 240, 49, BG_COLOR); // Clear gap and bg
-  card_spr.fillRoundRect(card_x, 5, card_width, card_height, 10, CARD_COLOR); // Draw card at local Y=5
-  
-  draw_lux_icon(&card_spr, card_x + 15, 7); // Nudged up
-  
-  card_spr.setTextDatum(TR_DATUM); 
-  card_spr.setTextColor(SENSOR_COLOR, CARD_COLOR);
-  card_spr.setTextSize(3);
+  draw_sensor_card(2, 89, 49, ICON_HUMIDITY, 7, val_buf);
+
+  // --- 3. Lux Card (Y=138) ---
   sprintf(val_buf, "%.0f lx", data.lux); // Lux
-  card_spr.drawString(val_buf, card_x + 215, 15); // Local Y = 10 + 5
-  
-  card_spr.pushSprite(0, card_y); // Push sprite to screen Y=138
-  card_spr.deleteSprite();
-
-  // --- 4. Pressure Card (Full-width band) ---
-  card_y += 49; // New Y-pos (187)
-  // This sprite is 53px tall (5px gap + 44px card + 4px bottom gap)
-  card_spr.createSprite(240, 53);
-  card_spr.fillRect(0, 0, 240, 53, BG_COLOR); // Clear gap and bg
-  card_spr.fillRoundRect(card_x, 5, card_width, card_height, 10, CARD_COLOR); // Draw card at local Y=5
-  
-  draw_pressure_icon(&card_spr, card_x + 15, 7); // Nudged up
-  
-  card_spr.setTextDatum(TR_DATUM); 
-  card_spr.setTextColor(SENSOR_COLOR, CARD_COLOR);
-  card_spr.setTextSize(3);
+  draw_sensor_card(3, 138, 49, ICON_LUX, 7, val_buf);
+
+  // --- 4. Pressure Card (Y=187, 53px tall: 4px bottom gap) ---
   sprintf(val_buf, "%.0f hPa", data.barometricPressure); 
-  card_spr.drawString(val_buf, card_x + 215, 15); // Local Y = 10 + 5
-  
-  card_spr.pushSprite(0, card_y); // Push sprite to screen Y=187
-  card_spr.deleteSprite();
+  draw_sensor_card(4, 187, 53, ICON_PRESSURE, 7, val_buf);
 }
 
 
 // <--- Lights menu screen (Full Screen) --->
 void draw_lights_menu_screen(const DisplayData& data) {
   // This is a full-screen menu, so it draws over everything
-  // and does *not* call the footer.
-  tft.fillScreen(BG_COLOR); // Clear whole screen
+  // and does *not* call the footer. The chrome is drawn once on entry.
+  if (region_dirty(0, RegionInputs())) {
+    wait_band_dma();
+    tft.fillScreen(BG_COLOR); // Clear whole screen
+    count_direct_fill(240, 280);
+
+    // --- Header ---
+    tft.setTextDatum(TC_DATUM);
+    tft.setTextColor(LOAD_COLOR, BG_COLOR);
+    tft.setTextSize(3);
+    tft.drawString("LIGHTS MENU", 120, 5);
+    tft.drawFastHLine(10, 35, 220, CARD_COLOR);
+  }
 
   const char* menuItems[] = {"Toggle Light", "Motion Timer", "Manual Timer", "Back"};
 
-  // --- Header ---
-  tft.setTextDatum(TC_DATUM);
-  tft.setTextColor(LOAD_COLOR, BG_COLOR);
-  tft.setTextSize(3);
-  tft.drawString("LIGHTS MENU", 120, 5);
-  tft.drawFastHLine(10, 35, 220, CARD_COLOR);
-  
-  // --- Sprite 1: Menu Items 0 & 1 ---
-  TFT_eSprite item_spr_1 = TFT_eSprite(&tft);
-  item_spr_1.createSprite(240, 120); 
-  item_spr_1.fillRect(0, 0, 240, 120, BG_COLOR); 
-
-  item_spr_1.setTextDatum(TL_DATUM);
-  item_spr_1.setTextSize(2);
-  for (int i = 0; i < 2; i++) {
-    int yPos = 20 + i * 40; 
-    if (i == data.lightsMenuSelection) {
-      item_spr_1.fillRoundRect(20, yPos - 10, 200, 35, 5, LOAD_COLOR);
-      item_spr_1.setTextColor(SHADOW_COLOR, LOAD_COLOR);
-      item_spr_1.drawString(menuItems[i], 30, yPos);
-    } else {
-      item_spr_1.setTextColor(TEXT_COLOR, BG_COLOR);
-      item_spr_1.drawString(menuItems[i], 30, yPos);
-    }
-  }
-  item_spr_1.pushSprite(0, 40); // No transparency needed
-  item_spr_1.deleteSprite(); 
-
-  // --- Sprite 2: Menu Items 2 & 3 ---
-  TFT_eSprite item_spr_2 = TFT_eSprite(&tft);
-  item_spr_2.createSprite(240, 120); 
-  item_spr_2.fillRect(0, 0, 240, 120, BG_COLOR); 
-
-  item_spr_2.setTextDatum(TL_DATUM);
-  item_spr_2.setTextSize(2);
-  for (int i = 2; i < 4; i++) {
-    int yPos = 20 + (i-2) * 40; 
-    if (i == data.lightsMenuSelection) {
-      item_spr_2.fillRoundRect(20, yPos - 10, 200, 35, 5, LOAD_COLOR);
-      item_spr_2.setTextColor(SHADOW_COLOR, LOAD_COLOR);
-      item_spr_2.drawString(menuItems[i], 30, yPos);
-    } else {
-      item_spr_2.setTextColor(TEXT_COLOR, BG_COLOR);
-      item_spr_2.drawString(menuItems[i], 30, yPos);
+  // --- Sprites 1 and 2: Menu items 0 & 1, 2 & 3 ---
+  // Each only changes when the highlight enters or leaves it
+  for (int half = 0; half < 2; half++) {
+    int first = half * 2;
+    RegionInputs inputs;
+    bool selected_here = data.lightsMenuSelection >= first && data.lightsMenuSelection < first + 2;
+    inputs.number(selected_here ? data.lightsMenuSelection : -1);
+    if (!region_dirty(1 + half, inputs)) continue;
+
+    for (BandRenderer band(40 + half * 120, 120); band.next(); ) {
+      TFT_eSprite& item_spr = band.sprite();
+      item_spr.fillRect(0, 0, 240, 120, BG_COLOR); 
+
+      item_spr.setTextDatum(TL_DATUM);
+      item_spr.setTextSize(2);
+      for (int i = first; i < first + 2; i++) {
+        int yPos = 20 + (i - first) * 40; 
+        if (i == data.lightsMenuSelection) {
+          item_spr.fillRoundRect(20, yPos - 10, 200, 35, 5, LOAD_COLOR);
+          item_spr.setTextColor(SHADOW_COLOR, LOAD_COLOR);
+          item_spr.drawString(menuItems[i], 30, yPos);
+        } else {
+          item_spr.setTextColor(TEXT_COLOR, BG_COLOR);
+          item_spr.drawString(menuItems[i], 30, yPos);
+        }
+      }
     }
   }
-  item_spr_2.pushSprite(0, 160); // No transparency needed
-  item_spr_2.deleteSprite(); 
 }
 
 // <--- Screen for editing timers (Full Screen) --->
 void draw_lights_edit_timer_screen(const DisplayData& data) {
-  // This is also a full-screen menu
-  tft.fillScreen(BG_COLOR); 
-
   char buf[30];
   unsigned long durationToEdit;
   const char* title;
@@ -450,70 +974,85 @@ void draw_lights_edit_timer_screen(const DisplayData& data) {
       title = "Edit Manual Timer";
   }
 
-  // --- Header ---
-  tft.setTextDatum(TC_DATUM);
-  tft.setTextColor(LOAD_COLOR, BG_COLOR);
-  tft.setTextSize(3);
-  tft.drawString(title, 120, 5);
-  tft.drawFastHLine(10, 35, 220, CARD_COLOR);
-
-  // --- Create sprite for the body ---
-  TFT_eSprite body_spr = TFT_eSprite(&tft);
-  body_spr.createSprite(240, 244); 
-  body_spr.fillRect(0, 0, 240, 244, BG_COLOR); 
+  // This is also a full-screen menu; the title is part of the screen mode
+  if (region_dirty(0, RegionInputs())) {
+    wait_band_dma();
+    tft.fillScreen(BG_COLOR); 
+    count_direct_fill(240, 280);
+
+    // --- Header ---
+    tft.setTextDatum(TC_DATUM);
+    tft.setTextColor(LOAD_COLOR, BG_COLOR);
+    tft.setTextSize(3);
+    tft.drawString(title, 120, 5);
+    tft.drawFastHLine(10, 35, 220, CARD_COLOR);
+  }
 
-  // --- Display Time Value (to sprite) ---
-  body_spr.setTextDatum(MC_DATUM);
-  body_spr.setTextColor(TEXT_COLOR, BG_COLOR);
-  body_spr.setTextSize(5);
   unsigned long minutes = durationToEdit / 60000;
   unsigned long seconds = (durationToEdit % 60000) / 1000;
   sprintf(buf, "%02lu:%02lu", minutes, seconds);
-  body_spr.drawString(buf, 120, 94);
-
-  // --- Footer instructions (to sprite) ---
-  body_spr.setTextDatum(BC_DATUM);
-  body_spr.setTextSize(1);
-  body_spr.setTextColor(SUBTLE_TEXT_COLOR, BG_COLOR);
-  body_spr.drawString("Turn to adjust, Press to save", 120, 239);
-  
-  body_spr.pushSprite(0, 36);
-  body_spr.deleteSprite(); 
+  RegionInputs inputs;
+  const char* time_text = inputs.text(buf);
+  if (!region_dirty(1, inputs)) return;
+
+  // --- Body (drawn in strips through the band pool) ---
+  for (BandRenderer band(36, 244); band.next(); ) {
+    TFT_eSprite& body_spr = band.sprite();
+    body_spr.fillRect(0, 0, 240, 244, BG_COLOR); 
+
+    // --- Display Time Value (to sprite) ---
+    body_spr.setTextDatum(MC_DATUM);
+    body_spr.setTextColor(TEXT_COLOR, BG_COLOR);
+    body_spr.setTextSize(5);
+    body_spr.drawString(time_text, 120, 94);
+
+    // --- Footer instructions (to sprite) ---
+    body_spr.setTextDatum(BC_DATUM);
+    body_spr.setTextSize(1);
+    body_spr.setTextColor(SUBTLE_TEXT_COLOR, BG_COLOR);
+    body_spr.drawString("Turn to adjust, Press to save", 120, 239);
+  }
 }
 
 // --- NEW GLOBAL FOOTER ---
 void draw_global_footer_bar(const DisplayData& data) {
-  // Create a sprite for the footer area
-  TFT_eSprite footer_spr = TFT_eSprite(&tft);
-  footer_spr.createSprite(240, FOOTER_HEIGHT);
-  footer_spr.fillRect(0, 0, 240, FOOTER_HEIGHT, BG_COLOR); 
-
-  // Draw dividing line
-  footer_spr.drawFastHLine(0, 0, 240, CARD_COLOR);
-
-  // Draw Icons (Centered)
-  draw_footer_light_icon(&footer_spr, 70, 5, data.lightIsOn);
-  draw_footer_occupancy_icon(&footer_spr, 140, 5, data.occupancyDetected);
-
-  // --- Timer Progress Bar (at very bottom) ---
-  footer_spr.fillRect(0, FOOTER_HEIGHT - 4, 240, 4, BG_COLOR); 
-  
+  // --- Timer Progress Bar width (at very bottom) ---
+  int progressWidth = 0;
   if (data.lightIsOn && data.timerRemainingSeconds > 0) {
     unsigned long totalDurationSec = data.lightManualOverride ? 
                                      (data.manualTimerDuration / 1000) : 
                                      (data.motionTimerDuration / 1000);
     
     if (totalDurationSec > 0) {
-      int progressWidth = map(data.timerRemainingSeconds, 0, totalDurationSec, 0, 240);
+      progressWidth = map(data.timerRemainingSeconds, 0, totalDurationSec, 0, 240);
       if (progressWidth < 0) progressWidth = 0;
       if (progressWidth > 240) progressWidth = 240;
-      
-      footer_spr.fillRect(0, FOOTER_HEIGHT - 4, progressWidth, 4, LOAD_COLOR);
     }
   }
 
-  footer_spr.pushSprite(0, FOOTER_Y_START);
-  footer_spr.deleteSprite();
+  RegionInputs inputs;
+  inputs.number(data.lightIsOn);
+  inputs.number(data.occupancyDetected);
+  inputs.number(progressWidth);
+  if (!region_dirty(FOOTER_REGION, inputs)) return;
+
+  // Create a sprite for the footer area
+  for (BandRenderer band(FOOTER_Y_START, FOOTER_HEIGHT); band.next(); ) {
+    TFT_eSprite& footer_spr = band.sprite();
+    footer_spr.fillRect(0, 0, 240, FOOTER_HEIGHT, BG_COLOR); 
+
+    // Draw dividing line
+    footer_spr.drawFastHLine(0, 0, 240, CARD_COLOR);
+
+    // Draw Icons (Centered)
+    draw_icon(&footer_spr, data.lightIsOn ? ICON_LIGHT_ON : ICON_LIGHT_OFF, 70, 5);
+    draw_icon(&footer_spr, data.occupancyDetected ? ICON_OCCUPANCY_ON : ICON_OCCUPANCY_OFF, 140, 5);
+
+    footer_spr.fillRect(0, FOOTER_HEIGHT - 4, 240, 4, BG_COLOR); 
+    if (progressWidth > 0) {
+      footer_spr.fillRect(0, FOOTER_HEIGHT - 4, progressWidth, 4, LOAD_COLOR);
+    }
+  }
 }
 
 
@@ -648,7 +1187,15 @@ void draw_sun_icon(TFT_eSprite* spr, int x, int y) {
   }
 }
 
-void draw_battery_icon(TFT_eSprite* spr, int x, int y, float voltage) {
+// Charge level in pixels from the SoC estimate, or voltage until there is one
+int battery_fill_width(float soc, int32_t voltage_mv) {
+  int fill_width = soc >= 0 ? (int)(soc * 52 / 100) : map(voltage_mv, 11000, 13500, 0, 52); // 11.0V to 13.5V
+  if (fill_width < 0) fill_width = 0;
+  if (fill_width > 52) fill_width = 52;
+  return fill_width;
+}
+
+void draw_battery_body(TFT_eSprite* spr, int x, int y) {
   // Draw battery body
   spr->fillRoundRect(x, y + 8, 60, 35, 5, TEXT_COLOR);
   spr->fillRoundRect(x + 2, y + 10, 56, 31, 3, CARD_COLOR);
@@ -656,13 +1203,12 @@ void draw_battery_icon(TFT_eSprite* spr, int x, int y, float voltage) {
   // Draw battery terminals
   spr->fillRect(x + 10, y, 10, 8, TEXT_COLOR); // Left terminal
   spr->fillRect(x + 40, y, 10, 8, TEXT_COLOR); // Right terminal
+}
 
-  // Calculate charge level
-  int fill_width = map(voltage * 100, 1100, 1350, 0, 52); // 11.0V to 13.5V
-  if (fill_width < 0) fill_width = 0;
-  if (fill_width > 52) fill_width = 52;
-  
-  spr->fillRoundRect(x + 4, y + 12, fill_width, 27, 2, BATTERY_COLOR);
+void draw_battery_icon(TFT_eSprite* spr, int x, int y, int fill_width) {
+  // The body is cached; the fill level is a single overlay
+  draw_icon(spr, ICON_BATTERY_BODY, x, y);
+  if (fill_width > 0) spr->fillRoundRect(x + 4, y + 12, fill_width, 27, 2, BATTERY_COLOR);
 }
 
 void draw_load_icon(TFT_eSprite* spr, int x, int y) {
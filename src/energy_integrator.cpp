@@ -0,0 +1,63 @@
+#include "energy_integrator.h"
+
+// 1 uWh = 3.6 mJ = 3,600,000 nJ
+static const int64_t NJ_PER_UWH = 3600000;
+
+// Moves whole uWh out of a nJ remainder into its counter
+static inline void carry(int64_t& remainder_nj, uint64_t& counter_uwh) {
+  if (remainder_nj >= NJ_PER_UWH) {
+    int64_t whole = remainder_nj / NJ_PER_UWH;
+    counter_uwh += whole;
+    remainder_nj -= whole * NJ_PER_UWH;
+  }
+}
+
+void energy_integrator_reset(EnergyIntegrator& integrator) {
+  integrator.positive_uwh = 0;
+  integrator.negative_uwh = 0;
+  integrator.positive_nj = 0;
+  integrator.negative_nj = 0;
+  integrator.last_power_mw = 0;
+  integrator.last_time_us = 0;
+  integrator.started = false;
+}
+
+void energy_integrator_add(EnergyIntegrator& integrator, int32_t power_mw, uint32_t timestamp_us) {
+  uint32_t dt_us = timestamp_us - integrator.last_time_us; // Unsigned subtraction survives micros() wrap
+  int64_t p0 = integrator.last_power_mw;
+  int64_t p1 = power_mw;
+  integrator.last_power_mw = power_mw;
+  integrator.last_time_us = timestamp_us;
+
+  if (!integrator.started || dt_us > ENERGY_MAX_GAP_US) {
+    // First sample (or after a gap) just starts the clock
+    integrator.started = true;
+    return;
+  }
+
+  if (p0 >= 0 && p1 >= 0) {
+    integrator.positive_nj += (p0 + p1) * dt_us / 2;
+  } else if (p0 <= 0 && p1 <= 0) {
+    integrator.negative_nj += -(p0 + p1) * dt_us / 2;
+  } else {
+    // Sign change inside the step: the line crosses zero at p0/(p0-p1) of dt,
+    // giving two triangles of area p0^2*dt/(2*(p0-p1)) and p1^2*dt/(2*(p0-p1)).
+    int64_t span = 2 * (p0 > p1 ? p0 - p1 : p1 - p0);
+    int64_t first = p0 * p0 * dt_us / span;
+    int64_t second = p1 * p1 * dt_us / span;
+    if (p0 > 0) {
+      integrator.positive_nj += first;
+      integrator.negative_nj += second;
+    } else {
+      integrator.negative_nj += first;
+      integrator.positive_nj += second;
+    }
+  }
+
+  carry(integrator.positive_nj, integrator.positive_uwh);
+  carry(integrator.negative_nj, integrator.negative_uwh);
+}
+
+int64_t energy_integrator_net_uwh(const EnergyIntegrator& integrator) {
+  return (int64_t)integrator.positive_uwh - (int64_t)integrator.negative_uwh;
+}
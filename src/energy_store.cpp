@@ -0,0 +1,160 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_system.h>
+#include "energy_store.h"
+#include "power_monitor.h"
+#include "config.h"
+
+// --- Journal Record ---
+// One full copy of every channel's totals. Slots "a" and "b" are written
+// alternately; at boot the valid record with the highest seq wins.
+struct EnergyRecord {
+  uint32_t seq;
+  uint32_t channels;  // NUM_POWER_CHANNELS when written; a mismatch means the table changed
+  uint64_t positive_uwh[NUM_POWER_CHANNELS];
+  uint64_t negative_uwh[NUM_POWER_CHANNELS];
+  uint32_t crc;       // CRC-32 of everything above
+};
+
+static const char* NVS_NAMESPACE = "energy";
+static const char* SLOT_KEYS[2] = { "slot_a", "slot_b" };
+static const int32_t LOW_VOLTAGE_HYSTERESIS_MV = 300; // Above the threshold before the flush re-arms
+
+Preferences energyPrefs;
+EnergyRecord savedRecord = {};       // What is in flash right now
+bool energyStoreReady = false;
+unsigned long lastFlushTime = 0;
+bool lowVoltageFlushed = false;
+
+unsigned long flashWrites = 0;
+unsigned long flashBytesWritten = 0;
+
+// --- CRC-32 (reflected, poly 0xEDB88320) ---
+static uint32_t crc32(const uint8_t* data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static uint32_t record_crc(const EnergyRecord& record) {
+  return crc32((const uint8_t*)&record, offsetof(EnergyRecord, crc));
+}
+
+static bool read_slot(int slot, EnergyRecord& record) {
+  if (energyPrefs.getBytesLength(SLOT_KEYS[slot]) != sizeof(EnergyRecord)) return false;
+  energyPrefs.getBytes(SLOT_KEYS[slot], &record, sizeof(EnergyRecord));
+  return record.crc == record_crc(record) && record.channels == NUM_POWER_CHANNELS;
+}
+
+static void capture_totals(EnergyRecord& record) {
+  record.channels = NUM_POWER_CHANNELS;
+  for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+    get_energy_totals(i + 1, record.positive_uwh[i], record.negative_uwh[i]);
+  }
+}
+
+// Energy accumulated since the last write, summed over every counter
+static uint64_t unsaved_uwh(const EnergyRecord& current) {
+  uint64_t delta = 0;
+  for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+    delta += current.positive_uwh[i] - savedRecord.positive_uwh[i];
+    delta += current.negative_uwh[i] - savedRecord.negative_uwh[i];
+  }
+  return delta;
+}
+
+static void write_record(EnergyRecord& record) {
+  record.seq = savedRecord.seq + 1;
+  record.crc = record_crc(record);
+  // Odd sequence numbers go to slot b, so the slot we overwrite is always the older one
+  if (energyPrefs.putBytes(SLOT_KEYS[record.seq & 1], &record, sizeof(EnergyRecord)) == sizeof(EnergyRecord)) {
+    savedRecord = record;
+    flashWrites++;
+    flashBytesWritten += sizeof(EnergyRecord);
+  }
+  lastFlushTime = millis();
+}
+
+// Called by esp_restart() (OTA end, watchdog resets do not get here)
+static void shutdown_flush() {
+  energy_store_flush("restart");
+}
+
+void setup_energy_store() {
+  energyStoreReady = energyPrefs.begin(NVS_NAMESPACE, false);
+  if (!energyStoreReady) {
+    Serial.println("NVS open failed, energy totals will not persist.");
+    return;
+  }
+
+  EnergyRecord slots[2];
+  bool valid[2] = { read_slot(0, slots[0]), read_slot(1, slots[1]) };
+  int newest = -1;
+  if (valid[0] && valid[1]) newest = (int32_t)(slots[1].seq - slots[0].seq) > 0 ? 1 : 0;
+  else if (valid[0]) newest = 0;
+  else if (valid[1]) newest = 1;
+
+  if (newest >= 0) {
+    savedRecord = slots[newest];
+    for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+      restore_energy_totals(i + 1, savedRecord.positive_uwh[i], savedRecord.negative_uwh[i]);
+    }
+    Serial.printf("Energy totals restored (record %lu).\n", (unsigned long)savedRecord.seq);
+  } else {
+    Serial.println("No saved energy totals, starting from zero.");
+  }
+
+  if (esp_reset_reason() == ESP_RST_BROWNOUT) {
+    Serial.println("Last reset was a brownout; energy since the last flush was lost.");
+  }
+  esp_register_shutdown_handler(shutdown_flush);
+  lastFlushTime = millis();
+}
+
+void energy_store_flush(const char* reason) {
+  if (!energyStoreReady) return;
+  EnergyRecord current = savedRecord;
+  capture_totals(current);
+  if (unsaved_uwh(current) == 0) return;
+  write_record(current);
+  Serial.printf("Energy totals saved (%s).\n", reason);
+}
+
+void loop_energy_store() {
+  if (!energyStoreReady) return;
+  unsigned long now = millis();
+
+  // Battery sagging towards brownout: save once while there is still power to do it
+  int32_t voltage_mv = get_bus_millivolts(BATTERY_CHANNEL);
+  int32_t threshold_mv = lroundf(ENERGY_FLUSH_LOW_VOLTAGE * 1000);
+  if (voltage_mv > 0 && voltage_mv < threshold_mv) {
+    if (!lowVoltageFlushed) {
+      energy_store_flush("low voltage");
+      lowVoltageFlushed = true;
+    }
+  } else if (voltage_mv > threshold_mv + LOW_VOLTAGE_HYSTERESIS_MV) {
+    lowVoltageFlushed = false;
+  }
+
+  if (now - lastFlushTime < ENERGY_FLUSH_MIN_INTERVAL) return;
+
+  // Coalesce: write after a big change, or after a quiet interval if anything moved
+  EnergyRecord current = savedRecord;
+  capture_totals(current);
+  uint64_t delta = unsaved_uwh(current);
+  if (delta >= ENERGY_FLUSH_DELTA_UWH || (delta > 0 && now - lastFlushTime >= ENERGY_FLUSH_INTERVAL)) {
+    write_record(current);
+  }
+}
+
+void print_energy_store_stats() {
+  unsigned long uptime_s = millis() / 1000;
+  if (uptime_s == 0) uptime_s = 1;
+  unsigned long per_day = flashWrites * 86400UL / uptime_s;
+  Serial.printf("Energy store: %lu writes (%lu bytes), ~%lu writes/day (~%lu bytes/day), worst case %lu/day\n",
+                flashWrites, flashBytesWritten, per_day, per_day * (unsigned long)sizeof(EnergyRecord),
+                86400000UL / ENERGY_FLUSH_MIN_INTERVAL);
+}
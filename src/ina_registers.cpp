@@ -0,0 +1,90 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include "ina_registers.h"
+
+// --- Register Scaling ---
+static const int32_t INA226_SHUNT_LSB_NV = 2500; // 2.5 uV
+static const int32_t INA226_BUS_LSB_UV = 1250;   // 1.25 mV
+static const int32_t INA219_SHUNT_LSB_NV = 10000; // 10 uV
+static const int32_t INA219_BUS_LSB_MV = 4;       // 4 mV, value sits in bits 15..3
+static const int32_t INA3221_SHUNT_LSB_NV = 40000; // 40 uV, value sits in bits 15..3
+static const int32_t INA3221_BUS_LSB_MV = 8;       // 8 mV, value sits in bits 15..3
+
+bool ina_read_register(uint8_t address, uint8_t reg, uint16_t& value) {
+  // Pointer write and read share one transaction via a repeated start
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0) return false;
+  if (Wire.requestFrom(address, (uint8_t)2) != 2) return false;
+  value = ((uint16_t)Wire.read() << 8);
+  value |= (uint16_t)Wire.read();
+  return true;
+}
+
+bool ina_write_register(uint8_t address, uint8_t reg, uint16_t value) {
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  Wire.write((uint8_t)(value >> 8));
+  Wire.write((uint8_t)(value & 0xFF));
+  return Wire.endTransmission() == 0;
+}
+
+bool ina_read_pointed(uint8_t address, uint16_t& value) {
+  if (Wire.requestFrom(address, (uint8_t)2) != 2) return false;
+  value = ((uint16_t)Wire.read() << 8);
+  value |= (uint16_t)Wire.read();
+  return true;
+}
+
+int32_t ina226_shunt_to_ua(uint16_t raw, uint32_t shunt_uohm) {
+  int64_t shunt_nv = (int64_t)(int16_t)raw * INA226_SHUNT_LSB_NV;
+  return (int32_t)(shunt_nv * 1000 / shunt_uohm);
+}
+
+uint16_t ina226_ua_to_shunt(int32_t current_ua, uint32_t shunt_uohm) {
+  int64_t raw = (int64_t)current_ua * shunt_uohm / 1000 / INA226_SHUNT_LSB_NV;
+  if (raw > INT16_MAX) raw = INT16_MAX; // Clamp to the +/-81.92 mV range
+  if (raw < INT16_MIN) raw = INT16_MIN;
+  return (uint16_t)(int16_t)raw;
+}
+
+// Current and power from the raw shunt voltage, all in integer math
+static void compute_current_and_power(int64_t shunt_nv, int32_t bus_mv, uint32_t shunt_uohm, InaReading& reading) {
+  reading.bus_mv = bus_mv;
+  reading.current_ua = (int32_t)(shunt_nv * 1000 / shunt_uohm); // nV / uOhm = mA, so x1000 for uA
+  reading.power_mw = (int32_t)((int64_t)bus_mv * reading.current_ua / 1000000); // mV * uA = nW
+}
+
+bool ina226_read(uint8_t address, uint32_t shunt_uohm, InaReading& reading) {
+  uint16_t shunt_raw, bus_raw;
+  if (!ina_read_register(address, INA_REG_SHUNT_VOLTAGE, shunt_raw)) return false;
+  if (!ina_read_register(address, INA_REG_BUS_VOLTAGE, bus_raw)) return false;
+
+  int64_t shunt_nv = (int64_t)(int16_t)shunt_raw * INA226_SHUNT_LSB_NV; // Two's complement
+  int32_t bus_mv = (int32_t)bus_raw * INA226_BUS_LSB_UV / 1000;
+  compute_current_and_power(shunt_nv, bus_mv, shunt_uohm, reading);
+  return true;
+}
+
+bool ina219_read(uint8_t address, uint32_t shunt_uohm, InaReading& reading) {
+  uint16_t shunt_raw, bus_raw;
+  if (!ina_read_register(address, INA_REG_SHUNT_VOLTAGE, shunt_raw)) return false;
+  if (!ina_read_register(address, INA_REG_BUS_VOLTAGE, bus_raw)) return false;
+
+  int64_t shunt_nv = (int64_t)(int16_t)shunt_raw * INA219_SHUNT_LSB_NV; // Sign-extended for every PGA range
+  int32_t bus_mv = (int32_t)(bus_raw >> 3) * INA219_BUS_LSB_MV;
+  compute_current_and_power(shunt_nv, bus_mv, shunt_uohm, reading);
+  return true;
+}
+
+bool ina3221_read(uint8_t address, uint8_t input, uint32_t shunt_uohm, InaReading& reading) {
+  uint8_t shunt_reg = INA3221_REG_CH1_SHUNT + 2 * input;
+  uint16_t shunt_raw, bus_raw;
+  if (!ina_read_register(address, shunt_reg, shunt_raw)) return false;
+  if (!ina_read_register(address, shunt_reg + 1, bus_raw)) return false;
+
+  int64_t shunt_nv = (int64_t)((int16_t)shunt_raw >> 3) * INA3221_SHUNT_LSB_NV; // Arithmetic shift keeps the sign
+  int32_t bus_mv = (int32_t)((int16_t)bus_raw >> 3) * INA3221_BUS_LSB_MV;
+  compute_current_and_power(shunt_nv, bus_mv, shunt_uohm, reading);
+  return true;
+}
@@ -10,6 +10,10 @@
 #include "display_manager.h"
 #include "utils.h"
 #include "ota_manager.h"
+#include "diagnostics.h"
+#include "telemetry_buffer.h"
+#include "energy_store.h"
+#include "transient_capture.h"
 
 // --- Global Objects ---
 WiFiClient espClient;
@@ -42,7 +46,7 @@ unsigned long tempManualTimerDuration;
 
 // --- Non-Blocking Timers ---
 unsigned long lastDisplayUpdateTime = 0;
-unsigned long lastMqttReconnectAttempt = 0;
+bool otaStarted = false;
 unsigned long lastUserActivityTime = 0;
 int lastEncoderValue = 0;
 
@@ -51,53 +55,51 @@ void handle_input();
 
 
 // --- MQTT Update Handlers (for UI) ---
-void handle_light_state_update(String message);
-void handle_timer_remaining_update(String message);
-void handle_motion_timer_state_update(String message);
-void handle_manual_timer_state_update(String message);
-void handle_occupancy_state_update(String message);
+void handle_light_state_update(const char* message, unsigned int length);
+void handle_timer_remaining_update(const char* message, unsigned int length);
+void handle_motion_timer_state_update(const char* message, unsigned int length);
+void handle_manual_timer_state_update(const char* message, unsigned int length);
+void handle_occupancy_state_update(const char* message, unsigned int length);
 
 // --- Sensor State Update Handlers (for UI) ---
-void handle_temperature_update(String message);
-void handle_humidity_update(String message);
-void handle_pressure_update(String message);
-void handle_lux_update(String message);
+void handle_temperature_update(const char* message, unsigned int length);
+void handle_humidity_update(const char* message, unsigned int length);
+void handle_pressure_update(const char* message, unsigned int length);
+void handle_lux_update(const char* message, unsigned int length);
 
 void setup() {
   Serial.begin(115200);
 
   setup_display();
   setup_encoder();
-  setup_wifi();
+  setup_wifi(); // Non-blocking: sampling starts whether or not the AP is up
   setup_power_monitor();
+  setup_energy_store(); // Restores the energy totals before anything is published
+  setup_telemetry_buffer();
   
-  // Configure MQTT client
-  client.setServer(MQTT_SERVER, 1883);
-  client.setBufferSize(DEVICE_DISCOVERY_PAYLOAD_SIZE);
-  client.setCallback(mqtt_callback);
+  // WiFi and MQTT run on the network task from here on
+  setup_mqtt();
   
-  // Initialize OTA
-  setup_ota();
+  // OTA needs the network up (mDNS); it is started from loop() on the first WiFi connect
 
   lastUserActivityTime = millis();
   lastEncoderValue = get_encoder_value();
 }
 
 void loop() {
-  loop_ota();
-
-  if (!client.connected()) {
-    long now = millis();
-    if (now - lastMqttReconnectAttempt > 5000) {
-      lastMqttReconnectAttempt = now;
-      reconnect();
-    }
-  } else {
-    client.loop();
+  if (wifi_connected() && !otaStarted) {
+    setup_ota();
+    otaStarted = true;
   }
+  if (otaStarted) loop_ota();
+
+  loop_mqtt(); // Messages the network task received since the last pass
   
   handle_input(); // Handle user input
   loop_power_monitor(); // Run core logic for this device
+  loop_telemetry_buffer(); // Replay anything recorded while the broker was away
+  loop_energy_store();
+  loop_diagnostics();
 
   // Inactivity timer to reset the view
   if (millis() - lastUserActivityTime > INACTIVITY_TIMEOUT) {
@@ -112,11 +114,12 @@ void loop() {
     // Package up the current state into a data structure
     DisplayData data;
     // Power Data
-    for(int i=0; i<3; i++) {
-      data.busVoltage[i] = get_bus_voltage(i+1);
-      data.current[i] = get_current(i+1);
-      data.power[i] = get_power(i+1);
+    for(int i=0; i<NUM_POWER_CHANNELS; i++) {
+      data.busMillivolts[i] = get_bus_millivolts(i+1);
+      data.currentMilliamps[i] = get_current_microamps(i+1) / 1000;
+      data.powerMilliwatts[i] = get_power_milliwatts(i+1);
     }
+    data.batterySoc = get_battery_soc();
     // Light Status Data
     data.lightIsOn = lightIsOn;
     data.lightManualOverride = lightManualOverride; // This needs to be inferred or sent
@@ -158,11 +161,7 @@ void handle_input() {
   
   // --- UPDATED: New simplified state logic ---
   switch (currentMode) {
-    case POWER_MODE_ALL:
-    case POWER_MODE_CH1:
-    case POWER_MODE_CH2:
-    case POWER_MODE_CH3:
-    case SENSORS_MODE: // New screen included in this logic
+    default: // The overview, one screen per power channel, and the sensors
       // Handle knob turning (cycles through main screens)
       if (encoderChange != 0) {
         int modeIndex = (int)currentMode;
@@ -184,7 +183,7 @@ void handle_input() {
           // Button press on home screen opens the lights menu
           currentMode = LIGHTS_MENU;
           lightsMenuSelection = 0;
-        } else if (currentMode == POWER_MODE_CH1 || currentMode == POWER_MODE_CH2 || currentMode == POWER_MODE_CH3) {
+        } else if (is_power_channel_mode(currentMode)) {
           // Button press on channel screens toggles sub-screen
           currentPowerSubMode = (currentPowerSubMode == LIVE_POWER) ? POWER_SUBSCREEN : LIVE_POWER;
         } else if (currentMode == SENSORS_MODE) {
@@ -205,9 +204,9 @@ void handle_input() {
         switch (lightsMenuSelection) {
             case 0:   // Turn light On/Off
               if (lightIsOn) {
-                client.publish(MQTT_TOPIC_LIGHT_COMMAND, "OFF");
+                mqtt_publish(MQTT_TOPIC_LIGHT_COMMAND, "OFF");
               } else {
-                client.publish(MQTT_TOPIC_LIGHT_COMMAND, "ON");
+                mqtt_publish(MQTT_TOPIC_LIGHT_COMMAND, "ON");
                 lightManualOverride = true; // Set manual override when turned on via UI
               }
               break; 
@@ -237,7 +236,7 @@ void handle_input() {
         }
       }
       if (buttonPressed) {
-          client.publish(MQTT_TOPIC_MOTION_TIMER_COMMAND, String(tempMotionTimerDuration / 1000).c_str(), true);
+          mqtt_publish(MQTT_TOPIC_MOTION_TIMER_COMMAND, String(tempMotionTimerDuration / 1000).c_str(), true);
           currentMode = LIGHTS_MENU; // Go back to menu
       }
       break;
@@ -253,7 +252,7 @@ void handle_input() {
         }
       }
       if (buttonPressed) {
-          client.publish(MQTT_TOPIC_MANUAL_TIMER_COMMAND, String(tempManualTimerDuration / 1000).c_str(), true);
+          mqtt_publish(MQTT_TOPIC_MANUAL_TIMER_COMMAND, String(tempManualTimerDuration / 1000).c_str(), true);
           currentMode = LIGHTS_MENU; // Go back to menu
       }
       break;
@@ -262,9 +261,8 @@ void handle_input() {
 
 
 // --- MQTT Update Handlers ---
-void handle_light_state_update(String message) {
-    message.toUpperCase();
-    bool newLightState = (message == "ON");
+void handle_light_state_update(const char* message, unsigned int length) {
+    bool newLightState = (length == 2 && strncasecmp(message, "ON", 2) == 0);
 
     if (newLightState && !lightIsOn) { // <---- UPDATED (If state is changing to ON)
         lightOnTime = millis();       // <---- ADDED (Record the timestamp)
@@ -278,39 +276,38 @@ void handle_light_state_update(String message) {
     Serial.println(message);
 }
 
-void handle_motion_timer_state_update(String message) {
-    motionTimerDuration = message.toInt() * 1000;
+void handle_motion_timer_state_update(const char* message, unsigned int length) {
+    motionTimerDuration = strtol(message, nullptr, 10) * 1000;
 }
 
-void handle_manual_timer_state_update(String message) {
-    manualTimerDuration = message.toInt() * 1000;
+void handle_manual_timer_state_update(const char* message, unsigned int length) {
+    manualTimerDuration = strtol(message, nullptr, 10) * 1000;
 }
 
-void handle_timer_remaining_update(String message) {
-    timerRemainingSeconds = message.toInt();
+void handle_timer_remaining_update(const char* message, unsigned int length) {
+    timerRemainingSeconds = strtol(message, nullptr, 10);
 }
 
-void handle_occupancy_state_update(String message) {
-    message.toUpperCase();
-    bool occupancyState = (message == "ON");
+void handle_occupancy_state_update(const char* message, unsigned int length) {
+    bool occupancyState = (length == 2 && strncasecmp(message, "ON", 2) == 0);
     occupancyDetected = occupancyState;
 
     Serial.print("UI Updated: Occupancy state is now ");
     Serial.println(message);
 }
 
-void handle_temperature_update(String message) {
-    temperatureShed = message.toFloat();
+void handle_temperature_update(const char* message, unsigned int length) {
+    temperatureShed = strtof(message, nullptr);
 }
 
-void handle_humidity_update(String message) {
-    humidityShed = message.toFloat();
+void handle_humidity_update(const char* message, unsigned int length) {
+    humidityShed = strtof(message, nullptr);
 }
 
-void handle_pressure_update(String message) {
-    pressureShed = message.toFloat();
+void handle_pressure_update(const char* message, unsigned int length) {
+    pressureShed = strtof(message, nullptr);
 }
 
-void handle_lux_update(String message) {
-    luxShed = message.toFloat();
+void handle_lux_update(const char* message, unsigned int length) {
+    luxShed = strtof(message, nullptr);
 }
\ No newline at end of file
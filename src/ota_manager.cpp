@@ -3,6 +3,7 @@
 #include <WiFi.h>      // Needed for WiFi.localIP()
 #include "ota_manager.h"
 #include "config.h" // Needed for the DEVICE_ID
+#include "energy_store.h"
 
 void setup_ota() {
   // Set the hostname for the device. This is how it will appear on your network.
@@ -20,6 +21,7 @@ void setup_ota() {
       else // U_SPIFFS
         type = "filesystem";
       Serial.println("Start updating " + type);
+      energy_store_flush("OTA"); // Flash writes stall once the update is streaming
     })
     .onEnd([]() {
       Serial.println("\nEnd");
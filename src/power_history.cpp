@@ -0,0 +1,141 @@
+#include "power_history.h"
+#include "config.h"
+
+// --- Level Layout ---
+static const uint32_t LEVEL_PERIOD_S[HISTORY_LEVELS] = {1, 60, 900, 3600};
+static const uint16_t LEVEL_CAPACITY[HISTORY_LEVELS] = {240, 60, 96, 48};
+static const int BUCKETS_PER_CHANNEL = 240 + 60 + 96 + 48;
+
+// Open (still filling) bucket for one level
+struct OpenBucket {
+  bool active;
+  uint32_t period_index;  // start_s / period, identifies which bucket we are in
+  int32_t min_mw;
+  int32_t max_mw;
+  int64_t sum_mw;         // Sum of sample means, weighted by sample count
+  uint32_t samples;
+  int32_t energy_uwh;
+};
+
+struct HistoryLevel {
+  PowerAggregate* buckets;  // Slice of the channel's static pool
+  uint16_t head;            // Next slot to write
+  uint16_t count;
+  OpenBucket open;
+};
+
+struct ChannelHistory {
+  bool started;
+  uint32_t last_us;       // Last raw micros() value, to extend it to 64 bits
+  uint64_t clock_us;      // Wrap-free time since the first sample
+  int64_t bucket_energy_start_uwh; // Energy counter when the open 1s bucket began
+  int64_t last_energy_uwh;
+  HistoryLevel levels[HISTORY_LEVELS];
+};
+
+static PowerAggregate bucketPool[NUM_POWER_CHANNELS][BUCKETS_PER_CHANNEL];
+static ChannelHistory history[NUM_POWER_CHANNELS];
+
+static void init_channel(int channel) {
+  ChannelHistory& h = history[channel];
+  int offset = 0;
+  for (int level = 0; level < HISTORY_LEVELS; level++) {
+    h.levels[level].buckets = &bucketPool[channel][offset];
+    h.levels[level].head = 0;
+    h.levels[level].count = 0;
+    h.levels[level].open.active = false;
+    offset += LEVEL_CAPACITY[level];
+  }
+}
+
+static void open_bucket(OpenBucket& open, uint32_t period_index) {
+  open.active = true;
+  open.period_index = period_index;
+  open.min_mw = INT32_MAX;
+  open.max_mw = INT32_MIN;
+  open.sum_mw = 0;
+  open.samples = 0;
+  open.energy_uwh = 0;
+}
+
+static void merge_into(OpenBucket& open, int32_t min_mw, int32_t max_mw, int64_t sum_mw, uint32_t samples, int32_t energy_uwh) {
+  if (min_mw < open.min_mw) open.min_mw = min_mw;
+  if (max_mw > open.max_mw) open.max_mw = max_mw;
+  open.sum_mw += sum_mw;
+  open.samples += samples;
+  open.energy_uwh += energy_uwh;
+}
+
+static void close_bucket(ChannelHistory& h, int level);
+
+// Merges a just-closed child bucket into `level`, closing `level` first if
+// the child belongs to a later period.
+static void cascade(ChannelHistory& h, int level, const OpenBucket& child, uint32_t child_start_s) {
+  if (level >= HISTORY_LEVELS) return;
+  OpenBucket& open = h.levels[level].open;
+  uint32_t period_index = child_start_s / LEVEL_PERIOD_S[level];
+  if (open.active && open.period_index != period_index) close_bucket(h, level);
+  if (!open.active) open_bucket(open, period_index);
+  merge_into(open, child.min_mw, child.max_mw, child.sum_mw, child.samples, child.energy_uwh);
+}
+
+static void close_bucket(ChannelHistory& h, int level) {
+  HistoryLevel& lvl = h.levels[level];
+  OpenBucket& open = lvl.open;
+  if (!open.active || open.samples == 0) {
+    open.active = false;
+    return;
+  }
+
+  PowerAggregate& out = lvl.buckets[lvl.head];
+  out.start_s = open.period_index * LEVEL_PERIOD_S[level];
+  out.min_mw = open.min_mw;
+  out.max_mw = open.max_mw;
+  out.mean_mw = (int32_t)(open.sum_mw / open.samples);
+  out.energy_uwh = open.energy_uwh;
+  lvl.head = (lvl.head + 1) % LEVEL_CAPACITY[level];
+  if (lvl.count < LEVEL_CAPACITY[level]) lvl.count++;
+
+  open.active = false;
+  cascade(h, level + 1, open, out.start_s);
+}
+
+void power_history_add(int channel, uint32_t timestamp_us, int32_t power_mw, int64_t energy_uwh) {
+  if (channel < 0 || channel >= NUM_POWER_CHANNELS) return;
+  ChannelHistory& h = history[channel];
+
+  if (!h.started) {
+    init_channel(channel);
+    h.started = true;
+    h.last_us = timestamp_us;
+    h.clock_us = 0;
+    h.bucket_energy_start_uwh = energy_uwh;
+  }
+  h.clock_us += (uint32_t)(timestamp_us - h.last_us); // Unsigned delta survives micros() wrap
+  h.last_us = timestamp_us;
+  h.last_energy_uwh = energy_uwh;
+
+  uint32_t now_s = (uint32_t)(h.clock_us / 1000000);
+  OpenBucket& open = h.levels[HISTORY_1S].open;
+  if (open.active && open.period_index != now_s) {
+    open.energy_uwh = (int32_t)(energy_uwh - h.bucket_energy_start_uwh);
+    h.bucket_energy_start_uwh = energy_uwh;
+    close_bucket(h, HISTORY_1S);
+  }
+  if (!open.active) open_bucket(open, now_s);
+  merge_into(open, power_mw, power_mw, power_mw, 1, 0);
+}
+
+int power_history_count(int channel, HistoryResolution resolution) {
+  if (channel < 0 || channel >= NUM_POWER_CHANNELS || resolution >= HISTORY_LEVELS) return 0;
+  if (!history[channel].started) return 0;
+  return history[channel].levels[resolution].count;
+}
+
+bool power_history_get(int channel, HistoryResolution resolution, int age, PowerAggregate& out) {
+  if (age < 0 || age >= power_history_count(channel, resolution)) return false;
+  const HistoryLevel& lvl = history[channel].levels[resolution];
+  int capacity = LEVEL_CAPACITY[resolution];
+  out = lvl.buckets[(lvl.head - 1 - age + capacity) % capacity];
+  return true;
+}
@@ -1,34 +1,138 @@
 #include <Arduino.h>
-#include <Wire.h> 
-#include <INA226.h>
-#include <Adafruit_INA219.h>
+#include <Wire.h>
 #include <PubSubClient.h>
 #include "connections.h"
 #include "power_monitor.h"
 #include "config.h"
+#include "spsc_ring.h"
+#include "energy_integrator.h"
+#include "ina_registers.h"
+#include "power_drivers.h"
+#include "power_history.h"
+#include "publish_filter.h"
+#include "telemetry_buffer.h"
+#include "battery_soc.h"
+#include "transient_capture.h"
+#include "utils.h"
 
-// Pointers are initialized to nullptr to indicate they are not yet assigned.
-// --- MODIFICATION: ina_ch1 is now an INA219, ch2 and ch3 are still INA226 ---
-Adafruit_INA219 *ina_ch1 = nullptr; // <-- CHANGED
-// INA226 *ina_ch1 = nullptr;
-INA226 *ina_ch2 = nullptr;
-INA226 *ina_ch3 = nullptr;
+// --- Sample Hand-off ---
+// Every reading taken by the sampling task becomes one PowerSample. Samples go
+// through a lock-free ring to loop_power_monitor(), which does the energy math
+// and publishing, so a stalled loop() only delays processing, it never loses readings.
+// Values stay in the chip's integer units from the register read to the
+// publish/display formatting; nothing on the way converts to float.
+struct PowerSample {
+  uint32_t timestamp_us; // micros() when the reading was taken
+  uint8_t channel;       // 0-based index into POWER_CHANNELS
+  int32_t bus_mv;
+  int32_t current_ua;    // uA keeps the INA219's sub-mA resolution
+  int32_t power_mw;
+};
 
-// --- Add a new global array to track sensor status ---
-bool sensor_online[3] = {false, false, false};
+// ~75 samples/s across all channels (2 x ~28 Hz ALERT + 20 Hz poll), so 1024 slots ride out a ~13s stall of loop()
+SpscRing<PowerSample, 1024> sampleRing;
+volatile unsigned long samplesDropped = 0; // Only written by the sampling task
 
-// Variables to hold the latest sensor readings for all 3 channels
-float busVoltage[3] = {0.0, 0.0, 0.0};
-float current_ma[3] = {0.0, 0.0, 0.0};
-float power_mw[3] = {0.0, 0.0, 0.0};
-float totalEnergyWh[3] = {0.0, 0.0, 0.0}; // Variables to hold cumulative energy in Watt-hours for all 3 channels
-float batteryEnergyChargeWh = 0.0;
-float batteryEnergyDischargeWh = 0.0;
+// --- Latest-Value Snapshot (seqlock) ---
+// Written by the sampling task, read by the getters from any task. The writer
+// bumps `seq` to odd before writing and back to even after; readers retry if
+// they saw an odd value or the counter moved while they were copying.
+struct PowerSnapshot {
+  int32_t bus_mv[NUM_POWER_CHANNELS];
+  int32_t current_ua[NUM_POWER_CHANNELS];
+  int32_t power_mw[NUM_POWER_CHANNELS];
+};
+PowerSnapshot snapshot = {};
+std::atomic<uint32_t> snapshotSeq{0};
 
+// --- Publish Window ---
+// Running mean/min/max of one measurement over the current publish window.
+struct WindowStat {
+  int64_t sum;
+  int32_t min;
+  int32_t max;
+};
 
-// Non-blocking timer for sensor reads
-unsigned long lastSensorReadTime = 0;
-const int SENSOR_READ_INTERVAL = 250; // Read sensors every 250ms
+struct PublishWindow {
+  uint32_t samples;
+  WindowStat voltage;
+  WindowStat current;
+  WindowStat power;
+};
+
+// --- Per-Channel State ---
+// One entry per row of POWER_CHANNELS. The first block belongs to the
+// sampling task, the second to loop_power_monitor().
+struct ChannelState {
+  bool online;
+  bool alertDriven;               // Sampled on the chip's conversion-ready ALERT
+  uint32_t shuntMicroOhms;        // For the integer current math
+  unsigned long lastSampleTime;   // millis() of the last read attempt
+  volatile bool conversionReady;  // Set by the ALERT ISR
+  bool captureArmed;              // Over-current limit shares the ALERT pin (transient capture)
+  volatile uint32_t readTimeAvg_us;
+  volatile uint32_t readTimeMax_us;
+
+  // Consumer side (loop_power_monitor() only)
+  EnergyIntegrator energy;        // Bidirectional channels use the positive/negative split
+  PublishWindow window;           // Samples since the last publish
+};
+ChannelState channels[NUM_POWER_CHANNELS];
+
+// Last value sent for each SENSORS row
+PublishFilter sensorFilters[NUM_SENSORS];
+
+
+// --- Battery State of Charge ---
+// Fed from the BATTERY_CHANNEL samples in process_sample() (loop() side only).
+BatterySoc batterySoc;
+bool batterySocReady = false;
+PublishFilter batterySocFilter;
+
+// Filters whose last "sent" value was lost in the outbound table, set from any
+// task by power_monitor_publish_lost() and applied on loop() in publish_readings().
+// Bit s is sensorFilters[s]; bit NUM_SENSORS is batterySocFilter.
+std::atomic<uint32_t> lostPublishes{0};
+static_assert(NUM_SENSORS + 1 <= 32, "lostPublishes needs a bit per filter");
+
+// --- Sampling Task ---
+// Runs on the core that loop() does not use, above loop()'s priority, so
+// OTA and display pushes can't hold up the I2C reads.
+TaskHandle_t samplerTaskHandle = nullptr;
+void sampler_task(void* parameter);
+const int SAMPLER_TASK_CORE = 0;
+const int SAMPLER_TASK_PRIORITY = 3;
+const int SAMPLER_TASK_STACK = 4096;
+const int SAMPLER_IDLE_WAIT = 10; // ms to sleep when no alert arrives, bounds polling jitter
+
+volatile unsigned long i2cReadErrors = 0;
+volatile unsigned long firstSampleTime = 0; // millis() of the first good reading (boot timing)
+void benchmark_i2c_sweep();
+void benchmark_sample_path();
+uint32_t processCyclesAvg = 0; // CPU cycles per process_sample(), moving average
+
+// Publishing runs on its own window timer (POWER_PUBLISH_WINDOW), independent
+// of how fast the channels are sampled (ALERT rate or POWER_POLL_INTERVAL).
+unsigned long lastPublishTime = 0;
+
+// --- Conversion-Ready Alerts ---
+// INA226s are set up to pull their ALERT pin low when a new conversion is ready,
+// so sampling follows the chip's own conversion clock instead of loop() timing.
+// 16 averages x (1.1ms bus + 1.1ms shunt) = ~35ms per conversion.
+// If an alert never shows up (pin not wired, missing pull-up) we fall back to polling.
+const int ALERT_TIMEOUT = 250;
+
+// --- Conversion-Ready ISR ---
+// Shared by every ALERT pin; the argument is the channel index. Only set a
+// flag and wake the sampling task; the I2C read happens there.
+void IRAM_ATTR handle_conversion_ready(void* arg) {
+  channels[(int)(intptr_t)arg].conversionReady = true;
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  if (samplerTaskHandle != nullptr) {
+    vTaskNotifyGiveFromISR(samplerTaskHandle, &higherPriorityTaskWoken);
+  }
+  if (higherPriorityTaskWoken) portYIELD_FROM_ISR();
+}
 
 
 // Helper function to check for an I2C device ---
@@ -38,151 +142,709 @@ bool check_i2c_device(uint8_t address) {
   return (Wire.endTransmission() == 0);
 }
 
+// Helper function to route a conversion-ready alert to a GPIO interrupt ---
+bool setup_conversion_ready_alert(int ch) {
+  const PowerChannelConfig& cfg = POWER_CHANNELS[ch];
+  if (cfg.alert_pin < 0 || !power_driver_enable_ready_alert(cfg)) return false;
+
+  // ALERT is open-drain, active-low. GPIO 34/35 have no internal pull-ups,
+  // so the pull-up on the breakout board is what holds the line high.
+  pinMode(cfg.alert_pin, INPUT);
+  attachInterruptArg(digitalPinToInterrupt(cfg.alert_pin), handle_conversion_ready, (void*)(intptr_t)ch, FALLING);
+  return true;
+}
+
 void setup_power_monitor() {
-  Serial.println("Initializing INA226 Sensor...");
+  Serial.println("Initializing power monitor channels...");
 
   // --- Initialize the I2C bus FIRST ---
-  Wire.begin();
-  
-  // Conditional Initialization for Channel 1 ---
-  sensor_online[0] = check_i2c_device(INA226_CH1_ADDRESS);
-  if (sensor_online[0]) {
-    ina_ch1 = new Adafruit_INA219(INA226_CH1_ADDRESS);
-    ina_ch1->setCalibration_32V_2A(); // Configure for 32V, 2A range
-    ina_ch1->begin();
-    // ina_ch1 = new INA226();
-    // ina_ch1->begin(INA226_CH1_ADDRESS);
-    // ina_ch1->configure(INA226_AVERAGES_16, INA226_BUS_CONV_TIME_1100US, INA226_SHUNT_CONV_TIME_1100US, INA226_MODE_SHUNT_BUS_CONT);
-    // ina_ch1->calibrate(INA226_CH1_SHUNT, 10);
-    // Serial.println("INA226 Channel 1 (Solar Panel) Initialized.");
-    Serial.println("INA219 Channel 1 (Solar Panel) Initialized.");
-  } else {
-    // Serial.println("INA226 Channel 1 not found.");
-    Serial.println("INA219 Channel 1 not found.");
-  }
-
-  // Conditional Initialization for Channel 2 ---
-  sensor_online[1] = check_i2c_device(INA226_CH2_ADDRESS);
-  if (sensor_online[1]) {
-    ina_ch2 = new INA226();
-    ina_ch2->begin(INA226_CH2_ADDRESS);
-    ina_ch2->configure(INA226_AVERAGES_16, INA226_BUS_CONV_TIME_1100US, INA226_SHUNT_CONV_TIME_1100US, INA226_MODE_SHUNT_BUS_CONT);
-    ina_ch2->calibrate(INA226_CH2_SHUNT, 10);
-    Serial.println("INA226 Channel 2 (Battery) Initialized.");
-  } else {
-    Serial.println("INA226 Channel 2 not found.");
+  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN, I2C_CLOCK_HZ);
+
+  // --- Conditional Initialization for every channel in the table ---
+  for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+    const PowerChannelConfig& cfg = POWER_CHANNELS[i];
+    ChannelState& state = channels[i];
+    state.shuntMicroOhms = lroundf(cfg.shunt_ohms * 1000000);
+    energy_integrator_reset(state.energy);
+
+    state.online = check_i2c_device(cfg.address) && power_driver_begin(cfg);
+    if (state.online) {
+      state.alertDriven = setup_conversion_ready_alert(i);
+      state.captureArmed = state.alertDriven && cfg.capture_limit_a != 0 &&
+                           power_driver_arm_overcurrent(cfg, lroundf(cfg.capture_limit_a * 1000000), state.shuntMicroOhms);
+      Serial.printf("Channel %d (%s) at 0x%02X initialized%s%s.\n", i + 1, cfg.name, cfg.address,
+                    state.alertDriven ? ", sampling on ALERT" : ", polled",
+                    state.captureArmed ? ", transient capture armed" : "");
+    } else {
+      Serial.printf("Channel %d (%s) at 0x%02X not found.\n", i + 1, cfg.name, cfg.address);
+    }
   }
 
-  // Conditional Initialization for Channel 3 ---
-  sensor_online[2] = check_i2c_device(INA226_CH3_ADDRESS);
-  if (sensor_online[2]) {
-    ina_ch3 = new INA226();
-    ina_ch3->begin(INA226_CH3_ADDRESS);
-    ina_ch3->configure(INA226_AVERAGES_16, INA226_BUS_CONV_TIME_1100US, INA226_SHUNT_CONV_TIME_1100US, INA226_MODE_SHUNT_BUS_CONT);
-    ina_ch3->calibrate(INA226_CH3_SHUNT, 10);
-    Serial.println("INA226 Channel 3 (Load) Initialized.");
+  for (int s = 0; s < NUM_SENSORS; s++) publish_filter_reset(sensorFilters[s]);
+  publish_filter_reset(batterySocFilter);
+
+  if (ENABLE_DIAGNOSTICS) {
+    benchmark_i2c_sweep();
+    benchmark_sample_path();
+  }
+
+  // Hand the I2C bus over to the sampling task; nothing else touches Wire after this
+  xTaskCreatePinnedToCore(sampler_task, "power_sampler", SAMPLER_TASK_STACK, nullptr,
+                          SAMPLER_TASK_PRIORITY, &samplerTaskHandle, SAMPLER_TASK_CORE);
+}
+
+// --- Snapshot Helpers ---
+void write_snapshot(const PowerSample& sample) {
+  snapshotSeq.fetch_add(1, std::memory_order_acq_rel); // Odd: write in progress
+  std::atomic_thread_fence(std::memory_order_release);
+  snapshot.bus_mv[sample.channel] = sample.bus_mv;
+  snapshot.current_ua[sample.channel] = sample.current_ua;
+  snapshot.power_mw[sample.channel] = sample.power_mw;
+  std::atomic_thread_fence(std::memory_order_release);
+  snapshotSeq.fetch_add(1, std::memory_order_release); // Even: consistent again
+}
+
+PowerSnapshot read_snapshot() {
+  PowerSnapshot copy;
+  uint32_t before, after;
+  do {
+    before = snapshotSeq.load(std::memory_order_acquire);
+    copy = snapshot;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = snapshotSeq.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  return copy;
+}
+
+// --- Channel Reader (sampling task only) ---
+// Timestamps one reading and hands it to the ring and the snapshot.
+
+void record_read_time(ChannelState& state, uint32_t elapsed_us) {
+  // Exponential moving average (1/8 weight) keeps this cheap and overflow-free
+  state.readTimeAvg_us = state.readTimeAvg_us == 0 ? elapsed_us : (state.readTimeAvg_us * 7 + elapsed_us) / 8;
+  if (elapsed_us > state.readTimeMax_us) state.readTimeMax_us = elapsed_us;
+}
+
+// --- Transient Burst (sampling task only) ---
+// Runs when the over-current limit tripped. The burst spins on micros() to
+// hold the 140 us pacing (vTaskDelay() can't wait less than a tick), so the
+// priority-3 sampler keeps core 0 for up to CAPTURE_BURST_LIMIT_US:
+//  - the other INA226 channels' ALERT edges still set conversionReady, and
+//    they are read right after; each loses at most the one result the chip
+//    overwrote meanwhile (a conversion takes ~35 ms)
+//  - polled channels are read at most one POWER_POLL_INTERVAL late
+//  - the network task (also core 0, lower priority) waits out the burst
+// A slow bus ends the burst early at the limit rather than stretching it.
+// Returns true if the chip's registers were reconfigured for a burst, in
+// which case the result registers don't hold a normal averaged reading.
+static const uint32_t CAPTURE_BURST_LIMIT_US = CAPTURE_POST_SAMPLES * CAPTURE_SAMPLE_INTERVAL_US + 2000;
+
+bool capture_transient(int ch) {
+  const PowerChannelConfig& cfg = POWER_CHANNELS[ch];
+  ChannelState& state = channels[ch];
+  int32_t limit_ua = lroundf(cfg.capture_limit_a * 1000000);
+  TransientCapture* capture = capture_acquire(ch, limit_ua / 1000);
+  if (capture == nullptr) return false;
+
+  if (!power_driver_begin_burst(cfg)) {
+    capture_abort();
+    i2cReadErrors = i2cReadErrors + 1;
+    power_driver_end_burst(cfg); // begin_burst() may have got as far as the config register
+    power_driver_arm_overcurrent(cfg, limit_ua, state.shuntMicroOhms);
+    return true;
+  }
+
+  // Pace reads to the conversion time so no sample is a repeat of the last
+  int n = 0;
+  int32_t current_ua;
+  uint32_t start = micros();
+  uint32_t next = start;
+  while (n < CAPTURE_POST_SAMPLES && micros() - start < CAPTURE_BURST_LIMIT_US) {
+    while ((int32_t)(micros() - next) < 0) {}
+    next += CAPTURE_SAMPLE_INTERVAL_US;
+    if (!power_driver_read_burst(cfg, state.shuntMicroOhms, current_ua)) break;
+    capture->post_ma[n++] = current_ua / 1000;
+  }
+  capture->post_count = n;
+  capture->post_interval_us = n > 0 ? (micros() - start) / n : 0;
+
+  power_driver_end_burst(cfg);
+  power_driver_arm_overcurrent(cfg, limit_ua, state.shuntMicroOhms);
+  if (n > 0) {
+    capture_commit();
   } else {
-    Serial.println("INA226 Channel 3 not found.");
+    capture_abort();
+    i2cReadErrors = i2cReadErrors + 1;
   }
+  return true;
 }
 
-void loop_power_monitor() {
-  if (millis() - lastSensorReadTime > SENSOR_READ_INTERVAL) {
-    float timeDeltaHours = (float)SENSOR_READ_INTERVAL / 3600000.0; // (ms in interval) / (ms in hour)
-    lastSensorReadTime = millis();
-    char payloadBuffer[10]; // Reusable buffer for converting floats to strings
-    
-    // --- Read from Channel 1 ---
-    if (ina_ch1 != nullptr) {
-      busVoltage[0] = ina_ch1->getBusVoltage_V();   // readBusVoltage();
-      current_ma[0] = ina_ch1->getCurrent_mA();     // readShuntCurrent() * 1000; // Convert Amps to Milliamps
-      power_mw[0] = ina_ch1->getPower_mW();         // readBusPower() * 1000;       // Convert Watts to Milliwatts ---
-      totalEnergyWh[0] += (power_mw[0] / 1000.0) * timeDeltaHours; // (Power in mW to W) * hours
-
-      // Publish each measurement to its own topic
-      dtostrf(busVoltage[0], 1, 2, payloadBuffer);
-      client.publish(MQTT_TOPIC_SOLAR_PANEL_VOLTAGE_STATE, payloadBuffer, true);
-      
-      dtostrf(current_ma[0], 1, 2, payloadBuffer);
-      client.publish(MQTT_TOPIC_SOLAR_PANEL_CURRENT_STATE, payloadBuffer, true);
-
-      dtostrf(power_mw[0], 1, 2, payloadBuffer);
-      client.publish(MQTT_TOPIC_SOLAR_PANEL_POWER_STATE, payloadBuffer, true);
-      
-      dtostrf(totalEnergyWh[0], 1, 4, payloadBuffer);
-      client.publish(MQTT_TOPIC_SOLAR_PANEL_ENERGY_STATE, payloadBuffer, true);
+void read_channel(int ch) {
+  const PowerChannelConfig& cfg = POWER_CHANNELS[ch];
+  ChannelState& state = channels[ch];
+  uint32_t start = micros();
+  state.lastSampleTime = millis();
+
+  // Clear the flag and release ALERT before reading, so a conversion that
+  // completes while we are on the bus still produces a fresh edge.
+  InaReading reading;
+  if (state.alertDriven) {
+    state.conversionReady = false;
+    uint16_t flags;
+    if (!power_driver_ack_alert(cfg, flags)) {
+      i2cReadErrors = i2cReadErrors + 1;
+      return;
+    }
+    // end_burst() has only just restored the averaging config, so the result
+    // registers still hold a burst-mode value (the peak, or one mid-conversion).
+    // Skip this tick; the next conversion-ready alert brings a clean sample.
+    if (state.captureArmed && (flags & ALERT_FLAG_OVERLIMIT) && capture_transient(ch)) return;
+  }
+  if (!power_driver_read(cfg, state.shuntMicroOhms, reading)) {
+    i2cReadErrors = i2cReadErrors + 1; // Retried at the next poll instead of hammering the bus
+    return;
+  }
+  record_read_time(state, micros() - start);
+  if (firstSampleTime == 0) firstSampleTime = millis();
+
+  PowerSample sample;
+  sample.timestamp_us = micros();
+  sample.channel = ch;
+  sample.bus_mv = reading.bus_mv;
+  sample.current_ua = reading.current_ua;
+  sample.power_mw = reading.power_mw;
+
+  if (state.captureArmed) capture_note_sample(ch, sample.timestamp_us, reading.current_ua);
+  write_snapshot(sample);
+  if (!sampleRing.push(sample)) {
+    samplesDropped = samplesDropped + 1;
+  }
+}
+
+// --- I2C Sweep Benchmark ---
+// Runs once at boot, before the sampling task owns the bus. Times a full sweep
+// of every online channel through the register reader at I2C_CLOCK_HZ.
+// --- Library Baseline ---
+// The sweep as the chip libraries did it before the register reader, replayed
+// at register level so the boot benchmark keeps its "before" figure: 100 kHz,
+// three values per chip, each a pointer write, a stop and a separate read.
+//  - Adafruit INA219: bus, then current and power, each after rewriting calibration
+//  - INA226 library: bus, current and power, with its 1 ms delay before each read
+// INA3221 channels had no library path and are left out of the baseline.
+static const uint32_t LIBRARY_I2C_CLOCK_HZ = 100000;
+static const uint16_t INA219_LIBRARY_CALIBRATION = 4096; // setCalibration_32V_2A()
+
+static void library_read_register(uint8_t address, uint8_t reg, bool settle) {
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  Wire.endTransmission();
+  if (settle) delay(1);
+  Wire.requestFrom(address, (uint8_t)2);
+  while (Wire.available()) Wire.read();
+}
+
+static bool library_read_channel(const PowerChannelConfig& cfg) {
+  switch (cfg.chip) {
+    case CHIP_INA219:
+      library_read_register(cfg.address, INA_REG_BUS_VOLTAGE, false);
+      ina_write_register(cfg.address, INA_REG_CALIBRATION, INA219_LIBRARY_CALIBRATION);
+      library_read_register(cfg.address, INA_REG_CURRENT, false);
+      ina_write_register(cfg.address, INA_REG_CALIBRATION, INA219_LIBRARY_CALIBRATION);
+      library_read_register(cfg.address, INA_REG_POWER, false);
+      return true;
+    case CHIP_INA226:
+      library_read_register(cfg.address, INA_REG_BUS_VOLTAGE, true);
+      library_read_register(cfg.address, INA_REG_CURRENT, true);
+      library_read_register(cfg.address, INA_REG_POWER, true);
+      return true;
+    case CHIP_INA3221:
+      break;
+  }
+  return false;
+}
+
+void benchmark_i2c_sweep() {
+  const int iterations = 20;
+  InaReading reading;
+  int online = 0;
+
+  // Before: the library path, on the channels it covered
+  int library_channels = 0;
+  Wire.setClock(LIBRARY_I2C_CLOCK_HZ);
+  uint32_t start = micros();
+  for (int n = 0; n < iterations; n++) {
+    library_channels = 0;
+    for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+      if (channels[i].online && library_read_channel(POWER_CHANNELS[i])) library_channels++;
+    }
+  }
+  uint32_t library_us = (micros() - start) / iterations;
+  Wire.setClock(I2C_CLOCK_HZ);
+
+  // After: the register reader
+  start = micros();
+  for (int n = 0; n < iterations; n++) {
+    online = 0;
+    for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+      if (!channels[i].online) continue;
+      power_driver_read(POWER_CHANNELS[i], channels[i].shuntMicroOhms, reading);
+      online++;
+    }
+  }
+  uint32_t sweep_us = (micros() - start) / iterations;
+
+  Serial.printf("I2C sweep benchmark: library @%lukHz %lu us (%d channels), register reader @%lukHz %lu us (%d channels)\n",
+                (unsigned long)(LIBRARY_I2C_CLOCK_HZ / 1000), (unsigned long)library_us, library_channels,
+                (unsigned long)(I2C_CLOCK_HZ / 1000), (unsigned long)sweep_us, online);
+}
+
+// --- Sample Path Benchmark ---
+// Runs once at boot. Compares the float pipeline this module used to run
+// (register values -> float V/mA, float window sums, dtostrf at publish) with
+// the fixed-point one, in CPU cycles, over the same synthetic readings.
+void benchmark_sample_path() {
+  const int iterations = 256;
+  volatile int32_t sink = 0; // Keeps the compiler from dropping the work
+  char buf[24];
+
+  // Per-sample work: unit conversion plus the three window accumulators
+  uint32_t start = ESP.getCycleCount();
+  float fsum_v = 0, fsum_i = 0, fsum_p = 0;
+  for (int n = 0; n < iterations; n++) {
+    float voltage = (12000 + n) / 1000.0f;
+    float current = (512000 + n * 37) / 1000.0f;
+    float power = (float)(6000 + n);
+    fsum_v += voltage;
+    fsum_i += current;
+    fsum_p += power;
+    sink = lroundf(power);
+  }
+  uint32_t float_sample = (ESP.getCycleCount() - start) / iterations;
+
+  start = ESP.getCycleCount();
+  int64_t isum_v = 0, isum_i = 0, isum_p = 0;
+  for (int n = 0; n < iterations; n++) {
+    isum_v += 12000 + n;
+    isum_i += 512000 + n * 37;
+    isum_p += 6000 + n;
+    sink = 6000 + n;
+  }
+  uint32_t fixed_sample = (ESP.getCycleCount() - start) / iterations;
+
+  // Per published value: formatting one reading as text
+  start = ESP.getCycleCount();
+  for (int n = 0; n < iterations; n++) dtostrf((12000 + n) / 1000.0f, 1, 2, buf);
+  uint32_t float_format = (ESP.getCycleCount() - start) / iterations;
+
+  start = ESP.getCycleCount();
+  for (int n = 0; n < iterations; n++) format_fixed(buf, sizeof(buf), 12000 + n, 3, 2);
+  uint32_t fixed_format = (ESP.getCycleCount() - start) / iterations;
+
+  sink = sink + (int32_t)(fsum_v + fsum_i + fsum_p) + (int32_t)(isum_v + isum_i + isum_p);
+  Serial.printf("Sample path benchmark (cycles): per sample float %lu / fixed %lu, per value format dtostrf %lu / fixed %lu\n",
+                (unsigned long)float_sample, (unsigned long)fixed_sample,
+                (unsigned long)float_format, (unsigned long)fixed_format);
+}
+
+void sampler_task(void* parameter) {
+  for (;;) {
+    // Sleep until an ALERT ISR wakes us, or until it's time to poll
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SAMPLER_IDLE_WAIT));
+    unsigned long now = millis();
+
+    for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+      ChannelState& state = channels[i];
+      if (!state.online) continue;
+      // ALERT channels read on a finished conversion (or after a missed alert), the rest are polled
+      bool due = state.alertDriven
+                     ? (state.conversionReady || now - state.lastSampleTime > ALERT_TIMEOUT)
+                     : (now - state.lastSampleTime >= POWER_POLL_INTERVAL);
+      if (due) read_channel(i);
+    }
+  }
+}
+
+// --- Window Helpers ---
+void window_add(WindowStat& stat, int32_t value, uint32_t samples) {
+  if (samples == 0) {
+    stat.sum = stat.min = stat.max = value;
+    return;
+  }
+  stat.sum += value;
+  if (value < stat.min) stat.min = value;
+  if (value > stat.max) stat.max = value;
+}
+
+int32_t window_mean(const WindowStat& stat, uint32_t samples) {
+  if (samples == 0) return 0;
+  int64_t half = stat.sum < 0 ? -(int64_t)(samples / 2) : (int64_t)(samples / 2); // Round to nearest
+  return (int32_t)((stat.sum + half) / (int64_t)samples);
+}
+
+// --- Sample Processing (loop() side) ---
+// Integrates energy over the real time between a channel's samples, using the
+// timestamps taken at read time rather than when loop() got around to it.
+void process_sample(const PowerSample& sample) {
+  ChannelState& state = channels[sample.channel];
+  window_add(state.window.voltage, sample.bus_mv, state.window.samples);
+  window_add(state.window.current, sample.current_ua, state.window.samples);
+  window_add(state.window.power, sample.power_mw, state.window.samples);
+  state.window.samples++;
+
+  energy_integrator_add(state.energy, sample.power_mw, sample.timestamp_us);
+  power_history_add(sample.channel, sample.timestamp_us, sample.power_mw, energy_integrator_net_uwh(state.energy));
+
+  // The SoC model is float maths on one channel only; convert at its boundary
+  if (sample.channel == BATTERY_CHANNEL - 1) {
+    float voltage = sample.bus_mv / 1000.0f;
+    if (!batterySocReady) {
+      battery_soc_init(batterySoc, BATTERY_MODEL, voltage);
+      batterySocReady = true;
     }
+    battery_soc_update(batterySoc, BATTERY_MODEL, voltage, sample.current_ua / 1000.0f, sample.timestamp_us);
+  }
+}
+
+// --- Publishing ---
+// Two modes, picked by ENABLE_JSON_STATE:
+//  - per-topic: one retained message per measurement (the original layout)
+//  - JSON state: one retained document per channel, sensors pick their field with val_tpl
+// The network task counts what reaches the wire, so the two can be compared in diagnostics.
+
+// Window means and energy totals for one channel, in fixed-point units
+struct ChannelValues {
+  int32_t voltage_mv;
+  int32_t current_ua;
+  int32_t power_mw;
+  int64_t energy_uwh;
+  int64_t energy_in_uwh;
+  int64_t energy_out_uwh;
+};
+
+ChannelValues channel_values(const ChannelState& state) {
+  ChannelValues values;
+  values.voltage_mv = window_mean(state.window.voltage, state.window.samples);
+  values.current_ua = window_mean(state.window.current, state.window.samples);
+  values.power_mw = window_mean(state.window.power, state.window.samples);
+  values.energy_uwh = energy_integrator_net_uwh(state.energy);
+  values.energy_in_uwh = state.energy.positive_uwh;
+  values.energy_out_uwh = state.energy.negative_uwh;
+  return values;
+}
+
+// The fixed-point reading a SENSORS row publishes
+int64_t sensor_value(const SensorDef& sensor, const ChannelValues& values) {
+  switch (sensor.kind) {
+    case MEASURE_VOLTAGE:    return values.voltage_mv;
+    case MEASURE_CURRENT:    return values.current_ua;
+    case MEASURE_POWER:      return values.power_mw;
+    case MEASURE_ENERGY:     return values.energy_uwh;
+    case MEASURE_ENERGY_IN:  return values.energy_in_uwh;
+    case MEASURE_ENERGY_OUT: return values.energy_out_uwh;
+  }
+  return 0;
+}
 
-    // --- Read from Channel 2 ---
-    if (ina_ch2 != nullptr) {
-      busVoltage[1] = ina_ch2->readBusVoltage();
-      current_ma[1] = ina_ch2->readShuntCurrent() * 1000; // Convert Amps to Milliamps
-      power_mw[1] = ina_ch2->readBusPower() * 1000;       // Convert Watts to Milliwatts ---
-      totalEnergyWh[1] += (power_mw[1] / 1000.0) * timeDeltaHours; // (Power in mW to W) * hours
-      float batteryEnergyDeltaWh = (power_mw[1] / 1000.0) * timeDeltaHours; // Energy in Wh for this interval
-      if (batteryEnergyDeltaWh > 0) {
-        batteryEnergyChargeWh += batteryEnergyDeltaWh;  // Add to charge if positive
-      } else {
-        batteryEnergyDischargeWh += -batteryEnergyDeltaWh; // Add to discharge if negative
-      }
-
-      // Publish each measurement to its own topic
-      dtostrf(busVoltage[1], 1, 2, payloadBuffer);
-      client.publish(MQTT_TOPIC_BATTERY_VOLTAGE_STATE, payloadBuffer, true);
-      
-      dtostrf(current_ma[1], 1, 2, payloadBuffer);
-      client.publish(MQTT_TOPIC_BATTERY_CURRENT_STATE, payloadBuffer, true);
-
-      dtostrf(power_mw[1], 1, 2, payloadBuffer);
-      client.publish(MQTT_TOPIC_BATTERY_POWER_STATE, payloadBuffer, true);
-      
-      dtostrf(batteryEnergyChargeWh, 1, 4, payloadBuffer);
-      client.publish(MQTT_TOPIC_BATTERY_ENERGY_CHARGED_STATE, payloadBuffer, true);
-      
-      dtostrf(batteryEnergyDischargeWh, 1, 4, payloadBuffer);
-      client.publish(MQTT_TOPIC_BATTERY_ENERGY_DISCHARGED_STATE, payloadBuffer, true);
+// The filters compare in the published unit, which is what their deadbands are in
+float sensor_to_float(const SensorDef& sensor, int64_t value) {
+  static const float SCALE[] = { 1.0f, 1e-1f, 1e-2f, 1e-3f, 1e-4f, 1e-5f, 1e-6f };
+  return value * SCALE[sensor.scale];
+}
+
+// Peaks are worth sending even when the mean sat inside the deadband
+bool window_peaked(const PublishWindow& window) {
+  return window.power.max - window.power.min > POWER_DEADBAND.absolute;
+}
+
+// Publishes one sensor's value if it passed the deadband/heartbeat filter for its topic
+// Returns true if it was published.
+bool publish_sensor(int index, int64_t value, unsigned long now) {
+  const SensorDef& sensor = SENSORS[index];
+  float filtered = sensor_to_float(sensor, value);
+  if (!publish_filter_check(sensorFilters[index], *sensor.deadband, filtered, now)) return false;
+
+  char payloadBuffer[24];
+  format_fixed(payloadBuffer, sizeof(payloadBuffer), value, sensor.scale, sensor.decimals);
+  if (!mqtt_publish(sensor.state_topic, payloadBuffer, true)) return false;
+  publish_filter_sent(sensorFilters[index], filtered, now);
+  return true;
+}
+
+// Appends "key":value, to a JSON payload; returns the new length
+int append_json_field(char* out, size_t size, int len, const char* key, int64_t value, int scale, int decimals) {
+  int key_len = strlen(key) + 3; // "key":
+  if ((size_t)(len + key_len) >= size) return len;
+  out[len] = '"';
+  memcpy(out + len + 1, key, key_len - 3);
+  out[len + key_len - 2] = '"';
+  out[len + key_len - 1] = ':';
+  int value_len = format_fixed(out + len + key_len, size - len - key_len - 1, value, scale, decimals, ",");
+  if (value_len == 0) {
+    out[len] = '\0'; // Didn't fit: drop the key too
+    return len;
+  }
+  return len + key_len + value_len;
+}
+
+// Appends the window's min/max as JSON members, e.g.
+// "n":140,"p_min":..,"p_max":..,"i_min":..,"i_max":..,"v_min":..,"v_max":..
+// (trailing comma included; the caller closes the object)
+// Same units as the state: mW, mA from uA, V from mV.
+int format_window_fields(char* out, size_t size, int len, const PublishWindow& window) {
+  len = append_json_field(out, size, len, "n", window.samples, 0, 0);
+  len = append_json_field(out, size, len, "p_min", window.power.min, 0, 0);
+  len = append_json_field(out, size, len, "p_max", window.power.max, 0, 0);
+  len = append_json_field(out, size, len, "i_min", window.current.min, 3, 1);
+  len = append_json_field(out, size, len, "i_max", window.current.max, 3, 1);
+  len = append_json_field(out, size, len, "v_min", window.voltage.min, 3, 2);
+  len = append_json_field(out, size, len, "v_max", window.voltage.max, 3, 2);
+  return len;
+}
+
+// Replaces the trailing comma with the closing brace
+void close_json_object(char* out, int len) {
+  if (len > 0 && out[len - 1] == ',') out[len - 1] = '}';
+}
+
+// Publishes the window's min/max as a JSON attributes payload (per-topic mode)
+void publish_window_attributes(const char* topic, const PublishWindow& window) {
+  char payload[192] = "{";
+  int len = format_window_fields(payload, sizeof(payload), 1, window);
+  close_json_object(payload, len);
+  mqtt_publish(topic, payload, true);
+}
+
+void publish_channel_topics(int channel, unsigned long now) {
+  const PowerChannelConfig& cfg = POWER_CHANNELS[channel];
+  ChannelState& state = channels[channel];
+  ChannelValues values = channel_values(state);
+
+  // Each sensor has its own topic and its own filter; the state is the window mean
+  bool attributesDue = window_peaked(state.window);
+  for (int s = 0; s < NUM_SENSORS; s++) {
+    const SensorDef& sensor = SENSORS[s];
+    if (sensor.channel != channel) continue;
+    bool sent = publish_sensor(s, sensor_value(sensor, values), now);
+    if (sensor.attributes) attributesDue |= sent;
+  }
+
+  if (cfg.attributes_topic != nullptr && attributesDue) {
+    publish_window_attributes(cfg.attributes_topic, state.window);
+  }
+}
+
+// One document per channel, e.g.
+// {"v":13.21,"i":512.00,"p":6764,"e":12.3456,"n":140,"p_min":..,...}
+// The filters still decide: if any field moved (or a heartbeat is due) the
+// whole document goes out, otherwise nothing does.
+void publish_channel_json(int channel, unsigned long now) {
+  const PowerChannelConfig& cfg = POWER_CHANNELS[channel];
+  ChannelState& state = channels[channel];
+  ChannelValues values = channel_values(state);
+
+  // Every field is counted once: all sent with the document, or all skipped with it
+  bool due = window_peaked(state.window);
+  for (int s = 0; s < NUM_SENSORS && !due; s++) {
+    const SensorDef& sensor = SENSORS[s];
+    if (sensor.channel != channel) continue;
+    float value = sensor_to_float(sensor, sensor_value(sensor, values));
+    due = publish_filter_due(sensorFilters[s], *sensor.deadband, value, now);
+  }
+  if (!due) {
+    for (const SensorDef& sensor : SENSORS) {
+      if (sensor.channel == channel) publish_filter_skipped();
     }
+    return;
+  }
+
+  char payload[320] = "{";
+  int len = 1;
+  for (int s = 0; s < NUM_SENSORS; s++) {
+    const SensorDef& sensor = SENSORS[s];
+    if (sensor.channel != channel) continue;
+    len = append_json_field(payload, sizeof(payload), len, sensor.json_key,
+                            sensor_value(sensor, values), sensor.scale, sensor.decimals);
+  }
+  len = format_window_fields(payload, sizeof(payload), len, state.window);
+  close_json_object(payload, len);
 
-    // --- Read from Channel 3 ---
-    if (ina_ch3 != nullptr) {
-      busVoltage[2] = ina_ch3->readBusVoltage();
-      current_ma[2] = ina_ch3->readShuntCurrent() * 1000; // Convert Amps to Milliamps
-      power_mw[2] = ina_ch3->readBusPower() * 1000;       // Convert Watts to Milliwatts ---
-      totalEnergyWh[2] += (power_mw[2] / 1000.0) * timeDeltaHours; // (Power in mW to W) * hours
-
-      // Publish each measurement to its own topic
-      dtostrf(busVoltage[2], 1, 2, payloadBuffer);
-      client.publish(MQTT_TOPIC_LOAD_VOLTAGE_STATE, payloadBuffer, true);
-      
-      dtostrf(current_ma[2], 1, 2, payloadBuffer);
-      client.publish(MQTT_TOPIC_LOAD_CURRENT_STATE, payloadBuffer, true);
-      
-      dtostrf(power_mw[2], 1, 2, payloadBuffer);
-      client.publish(MQTT_TOPIC_LOAD_POWER_STATE, payloadBuffer, true);
-      
-      dtostrf(totalEnergyWh[2], 1, 4, payloadBuffer);
-      client.publish(MQTT_TOPIC_LOAD_ENERGY_STATE, payloadBuffer, true);
+  if (!mqtt_publish(cfg.state_topic, payload, true)) return;
+  for (int s = 0; s < NUM_SENSORS; s++) {
+    const SensorDef& sensor = SENSORS[s];
+    if (sensor.channel != channel) continue;
+    publish_filter_sent(sensorFilters[s], sensor_to_float(sensor, sensor_value(sensor, values)), now);
+  }
+}
+
+// A BATTERY_ESTIMATES value in tenths of its unit
+int32_t battery_estimate_tenths(BatteryEstimateKind kind) {
+  switch (kind) {
+    case ESTIMATE_SOC: return lround(batterySoc.soc * 1000);
+    case ESTIMATE_TIME_TO_EMPTY: return lroundf(batterySoc.tte_hours * 10);
+    case ESTIMATE_TIME_TO_FULL: return lroundf(batterySoc.ttf_hours * 10);
+    case ESTIMATE_EFFICIENCY: return lroundf(batterySoc.efficiency * 1000);
+  }
+  return 0;
+}
+
+// {"soc":81.4,"tte_h":12.3,"ttf_h":0.0,"eff":91.0}, one field per
+// BATTERY_ESTIMATES row, filtered on the SoC
+void publish_battery_soc(unsigned long now) {
+  if (!batterySocReady) return;
+  float soc_percent = batterySoc.soc * 100;
+  if (!publish_filter_check(batterySocFilter, SOC_DEADBAND, soc_percent, now)) return;
+
+  char payload[96] = "{";
+  int len = 1;
+  for (const BatteryEstimateDef& estimate : BATTERY_ESTIMATES) {
+    len = append_json_field(payload, sizeof(payload), len, estimate.json_key,
+                            battery_estimate_tenths(estimate.kind), 1, 1);
+  }
+  close_json_object(payload, len);
+  if (mqtt_publish(MQTT_TOPIC_BATTERY_SOC_STATE, payload, true)) {
+    publish_filter_sent(batterySocFilter, soc_percent, now);
+  }
+}
+
+void power_monitor_publish_lost(const char* topic) {
+  uint32_t lost = 0;
+  for (int s = 0; s < NUM_SENSORS; s++) {
+    const SensorDef& sensor = SENSORS[s];
+    const char* channel_topic = POWER_CHANNELS[sensor.channel].state_topic;
+    if (strcmp(topic, sensor.state_topic) == 0 || strcmp(topic, channel_topic) == 0) lost |= 1u << s;
+  }
+  if (strcmp(topic, MQTT_TOPIC_BATTERY_SOC_STATE) == 0) lost |= 1u << NUM_SENSORS;
+  if (lost != 0) lostPublishes.fetch_or(lost, std::memory_order_relaxed);
+}
+
+void publish_readings() {
+  unsigned long now = millis();
+
+  // Forget what the broker never got, so the deadband can't hold it back
+  uint32_t lost = lostPublishes.exchange(0, std::memory_order_relaxed);
+  for (int s = 0; s < NUM_SENSORS; s++) {
+    if (lost & (1u << s)) publish_filter_reset(sensorFilters[s]);
+  }
+  if (lost & (1u << NUM_SENSORS)) publish_filter_reset(batterySocFilter);
+  if (mqtt_connected()) publish_battery_soc(now);
+
+  for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+    ChannelState& state = channels[i];
+    if (!state.online || state.window.samples == 0) continue;
+
+    if (!mqtt_connected()) {
+      // Broker unreachable: keep the window for replay instead of losing it
+      ChannelValues values = channel_values(state);
+      telemetry_buffer_add(i, now, values.voltage_mv, values.current_ua / 1000, values.power_mw);
+    } else if (ENABLE_JSON_STATE) {
+      publish_channel_json(i, now);
+    } else {
+      publish_channel_topics(i, now);
+    }
+    state.window.samples = 0; // Start the next window
+  }
+}
+
+void loop_power_monitor() {
+  // Drain everything the sampling task produced since the last call
+  static bool firstSampleLogged = false;
+  PowerSample sample;
+  while (sampleRing.pop(sample)) {
+    if (!firstSampleLogged) {
+      firstSampleLogged = true;
+      Serial.printf("Boot to first sample: %lu ms\n", firstSampleTime);
     }
+    uint32_t start = ESP.getCycleCount();
+    process_sample(sample);
+    uint32_t cycles = ESP.getCycleCount() - start;
+    processCyclesAvg = processCyclesAvg == 0 ? cycles : (processCyclesAvg * 7 + cycles) / 8;
+  }
+
+  if (millis() - lastPublishTime >= POWER_PUBLISH_WINDOW) {
+    lastPublishTime = millis();
+    publish_readings();
   }
 }
 
 // --- Data Getter Functions ---
-float get_bus_voltage(int channel) {
-  if (channel >= 1 && channel <= 3) return busVoltage[channel - 1];
-  return 0.0;
+// Channels are numbered from 1, matching the table order in config.cpp.
+// These read the seqlock snapshot, so they are safe from any task and always
+// return a voltage/current/power set that came from the same reading.
+int get_channel_count() {
+  return NUM_POWER_CHANNELS;
+}
+
+int32_t get_bus_millivolts(int channel) {
+  if (channel >= 1 && channel <= NUM_POWER_CHANNELS) return read_snapshot().bus_mv[channel - 1];
+  return 0;
 }
 
-float get_current(int channel) {
-  if (channel >= 1 && channel <= 3) return current_ma[channel - 1];
-  return 0.0;
+int32_t get_current_microamps(int channel) {
+  if (channel >= 1 && channel <= NUM_POWER_CHANNELS) return read_snapshot().current_ua[channel - 1];
+  return 0;
 }
 
-float get_power(int channel) {
-  if (channel >= 1 && channel <= 3) return power_mw[channel - 1];
-  return 0.0;
+int32_t get_power_milliwatts(int channel) {
+  if (channel >= 1 && channel <= NUM_POWER_CHANNELS) return read_snapshot().power_mw[channel - 1];
+  return 0;
 }
 
 bool is_sensor_online(int channel) {
-  if (channel >= 1 && channel <= 3) return sensor_online[channel - 1];
+  if (channel >= 1 && channel <= NUM_POWER_CHANNELS) return channels[channel - 1].online;
   return false;
-}
\ No newline at end of file
+}
+
+float get_battery_soc() {
+  return batterySocReady ? batterySoc.soc * 100 : -1.0f;
+}
+
+float get_battery_time_to_empty() {
+  return batterySocReady ? batterySoc.tte_hours : 0.0f;
+}
+
+float get_battery_time_to_full() {
+  return batterySocReady ? batterySoc.ttf_hours : 0.0f;
+}
+
+unsigned long get_first_sample_time() {
+  return firstSampleTime;
+}
+
+unsigned long get_samples_dropped() {
+  return samplesDropped;
+}
+
+void get_energy_totals(int channel, uint64_t& positive_uwh, uint64_t& negative_uwh) {
+  positive_uwh = negative_uwh = 0;
+  if (channel < 1 || channel > NUM_POWER_CHANNELS) return;
+  positive_uwh = channels[channel - 1].energy.positive_uwh;
+  negative_uwh = channels[channel - 1].energy.negative_uwh;
+}
+
+// Only called from loop() at boot, so it can't race process_sample()
+void restore_energy_totals(int channel, uint64_t positive_uwh, uint64_t negative_uwh) {
+  if (channel < 1 || channel > NUM_POWER_CHANNELS) return;
+  channels[channel - 1].energy.positive_uwh = positive_uwh;
+  channels[channel - 1].energy.negative_uwh = negative_uwh;
+}
+
+void print_power_monitor_stats() {
+  uint32_t sweep_us = 0;
+  for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+    if (!channels[i].online) continue;
+    Serial.printf("CH%d I2C read: avg %lu us, max %lu us\n", i + 1,
+                  (unsigned long)channels[i].readTimeAvg_us, (unsigned long)channels[i].readTimeMax_us);
+    sweep_us += channels[i].readTimeAvg_us;
+  }
+  Serial.printf("I2C bus time per full sweep: %lu us\n", (unsigned long)sweep_us);
+  Serial.printf("I2C read errors: %lu, samples dropped: %lu\n", i2cReadErrors, samplesDropped);
+  Serial.printf("Sample processing: avg %lu cycles\n", (unsigned long)processCyclesAvg);
+
+  // Last closed minute from the history cascade; no re-scan of samples
+  for (int i = 0; i < NUM_POWER_CHANNELS; i++) {
+    PowerAggregate minute;
+    if (!power_history_get(i, HISTORY_1MIN, 0, minute)) continue;
+    Serial.printf("CH%d last minute: mean %ld mW (min %ld, max %ld), %ld uWh\n", i + 1,
+                  (long)minute.mean_mw, (long)minute.min_mw, (long)minute.max_mw, (long)minute.energy_uwh);
+  }
+}
@@ -0,0 +1,51 @@
+#include <Arduino.h>
+#include <math.h>
+#include "publish_filter.h"
+
+unsigned long publishFilterSent = 0;
+unsigned long publishFilterSuppressed = 0;
+
+void publish_filter_reset(PublishFilter& filter) {
+  filter.last_value = 0;
+  filter.last_sent_ms = 0;
+  filter.has_value = false;
+}
+
+bool publish_filter_due(const PublishFilter& filter, const PublishDeadband& deadband, float value, uint32_t now_ms) {
+  if (!filter.has_value) return true;
+  if (now_ms - filter.last_sent_ms >= deadband.max_silence_ms) return true;
+
+  float threshold = fmaxf(deadband.absolute, deadband.relative * fabsf(filter.last_value));
+  return fabsf(value - filter.last_value) > threshold;
+}
+
+bool publish_filter_check(const PublishFilter& filter, const PublishDeadband& deadband, float value, uint32_t now_ms) {
+  if (publish_filter_due(filter, deadband, value, now_ms)) return true;
+  publishFilterSuppressed++;
+  return false;
+}
+
+void publish_filter_skipped() {
+  publishFilterSuppressed++;
+}
+
+void publish_filter_sent(PublishFilter& filter, float value, uint32_t now_ms) {
+  filter.last_value = value;
+  filter.last_sent_ms = now_ms;
+  filter.has_value = true;
+  publishFilterSent++;
+}
+
+unsigned long get_publish_filter_sent() {
+  return publishFilterSent;
+}
+
+unsigned long get_publish_filter_suppressed() {
+  return publishFilterSuppressed;
+}
+
+void print_publish_filter_stats() {
+  unsigned long total = publishFilterSent + publishFilterSuppressed;
+  Serial.printf("MQTT publish filter: %lu sent, %lu suppressed (%lu%%)\n", publishFilterSent, publishFilterSuppressed,
+                total == 0 ? 0UL : publishFilterSuppressed * 100 / total);
+}
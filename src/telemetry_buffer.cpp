@@ -0,0 +1,261 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <esp_system.h>
+#include "telemetry_buffer.h"
+#include "connections.h"
+#include "utils.h"
+#include "config.h"
+
+// --- Chunk Layout ---
+// A chunk is a header followed by encoded records:
+//   varint(ms since previous record) | channel byte | zigzag varint dV, dI, dP
+// Deltas are against the previous record of the same channel in the same
+// chunk (zero at the start of a chunk), so every chunk decodes on its own.
+// A typical 5 s window record is ~8 bytes instead of 17 raw.
+struct ChunkHeader {
+  uint16_t boot_id;   // Random per boot; timestamps only make sense within one boot
+  uint16_t length;    // Encoded bytes after the header
+  uint32_t base_ms;   // millis() of the first record
+  uint16_t records;
+  uint16_t reserved;
+};
+
+static const size_t CHUNK_SIZE = 2048;
+static const size_t MAX_RECORD_SIZE = 5 + 1 + 3 * 5; // Worst-case varints
+static const int RECORD_FIELDS = 3;                  // Voltage, current, power
+
+static const char* SPILL_PATH = "/telemetry.bin";
+static const uint32_t SPILL_MAX_BYTES = 256 * 1024; // ~14 h of 3 channels at 5 s windows
+static const unsigned long REPLAY_INTERVAL = 50;    // 20 replayed records/s at most
+
+// One side of the codec: the chunk being filled, or the chunk being replayed
+struct ChunkCursor {
+  ChunkHeader header;
+  uint8_t data[CHUNK_SIZE];
+  size_t pos;                                       // Read position (replay only)
+  uint16_t remaining;                               // Records left to read (replay only)
+  uint32_t last_ms;
+  int32_t last[NUM_POWER_CHANNELS][RECORD_FIELDS];
+};
+
+static ChunkCursor fillChunk;
+static ChunkCursor replayChunk;
+
+static bool fsReady = false;
+static uint16_t bootId = 0;
+static uint32_t spillSize = 0;       // Bytes in the spill file
+static uint32_t spillReadOffset = 0; // Next chunk to load from it
+static unsigned long lastReplayTime = 0;
+
+static unsigned long recordsBuffered = 0;
+static unsigned long recordsReplayed = 0;
+static unsigned long recordsDropped = 0;
+static unsigned long chunksSpilled = 0;
+
+// --- Varint Helpers ---
+static size_t put_varint(uint8_t* out, uint32_t value) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+static bool get_varint(const uint8_t* in, size_t length, size_t& pos, uint32_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 35 && pos < length; shift += 7) {
+    uint8_t b = in[pos++];
+    value |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+// Zigzag maps small negative deltas to small unsigned numbers
+static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+static void reset_cursor(ChunkCursor& chunk) {
+  memset(&chunk.header, 0, sizeof(chunk.header));
+  memset(chunk.last, 0, sizeof(chunk.last));
+  chunk.pos = 0;
+  chunk.remaining = 0;
+  chunk.last_ms = 0;
+}
+
+// --- Spilling ---
+// Appends the fill chunk to the spill file and starts a new one.
+static void spill_fill_chunk() {
+  size_t bytes = sizeof(ChunkHeader) + fillChunk.header.length;
+  if (!fsReady || spillSize + bytes > SPILL_MAX_BYTES) {
+    recordsDropped += fillChunk.header.records; // Flash is full; keep the oldest data
+  } else {
+    File file = LittleFS.open(SPILL_PATH, "a");
+    if (file) {
+      file.write((const uint8_t*)&fillChunk.header, sizeof(ChunkHeader));
+      file.write(fillChunk.data, fillChunk.header.length);
+      file.close();
+      spillSize += bytes;
+      chunksSpilled++;
+    } else {
+      recordsDropped += fillChunk.header.records;
+    }
+  }
+  reset_cursor(fillChunk);
+}
+
+void setup_telemetry_buffer() {
+  bootId = (uint16_t)esp_random();
+  reset_cursor(fillChunk);
+  reset_cursor(replayChunk);
+
+  fsReady = LittleFS.begin(true); // Format on first use
+  if (!fsReady) {
+    Serial.println("LittleFS mount failed, telemetry buffer is RAM only.");
+    return;
+  }
+
+  // Anything left from before a reboot is replayed first
+  if (LittleFS.exists(SPILL_PATH)) {
+    File file = LittleFS.open(SPILL_PATH, "r");
+    spillSize = file.size();
+    file.close();
+    Serial.printf("Telemetry backlog from a previous boot: %lu bytes\n", (unsigned long)spillSize);
+  }
+}
+
+void telemetry_buffer_add(uint8_t channel, uint32_t timestamp_ms, int32_t voltage_mv, int32_t current_ma, int32_t power_mw) {
+  if (channel >= NUM_POWER_CHANNELS) return;
+  if (fillChunk.header.length + MAX_RECORD_SIZE > CHUNK_SIZE) spill_fill_chunk();
+
+  ChunkHeader& header = fillChunk.header;
+  if (header.records == 0) {
+    header.boot_id = bootId;
+    header.base_ms = timestamp_ms;
+    fillChunk.last_ms = timestamp_ms;
+  }
+
+  int32_t values[RECORD_FIELDS] = { voltage_mv, current_ma, power_mw };
+  uint8_t* out = fillChunk.data + header.length;
+  size_t n = put_varint(out, timestamp_ms - fillChunk.last_ms);
+  out[n++] = channel;
+  for (int f = 0; f < RECORD_FIELDS; f++) {
+    n += put_varint(out + n, zigzag(values[f] - fillChunk.last[channel][f]));
+    fillChunk.last[channel][f] = values[f];
+  }
+  fillChunk.last_ms = timestamp_ms;
+  header.length += n;
+  header.records++;
+  recordsBuffered++;
+}
+
+// --- Replay ---
+// Loads the oldest pending chunk: the spill file first, then the RAM chunk.
+static bool load_replay_chunk() {
+  reset_cursor(replayChunk);
+
+  if (fsReady && spillReadOffset < spillSize) {
+    File file = LittleFS.open(SPILL_PATH, "r");
+    bool ok = file && file.seek(spillReadOffset) &&
+              file.read((uint8_t*)&replayChunk.header, sizeof(ChunkHeader)) == sizeof(ChunkHeader) &&
+              replayChunk.header.length <= CHUNK_SIZE &&
+              file.read(replayChunk.data, replayChunk.header.length) == replayChunk.header.length;
+    file.close();
+    spillReadOffset += sizeof(ChunkHeader) + replayChunk.header.length;
+
+    // Whole file consumed (or unreadable): start the next outage from an empty file
+    if (!ok || spillReadOffset >= spillSize) {
+      LittleFS.remove(SPILL_PATH);
+      spillSize = 0;
+      spillReadOffset = 0;
+    }
+    if (!ok) {
+      reset_cursor(replayChunk);
+      return false;
+    }
+  } else if (fillChunk.header.records > 0) {
+    replayChunk = fillChunk;
+    reset_cursor(fillChunk);
+  } else {
+    return false;
+  }
+
+  // Decoder state starts from zero, like the encoder did for this chunk
+  memset(replayChunk.last, 0, sizeof(replayChunk.last));
+  replayChunk.pos = 0;
+  replayChunk.remaining = replayChunk.header.records;
+  replayChunk.last_ms = replayChunk.header.base_ms;
+  return true;
+}
+
+// Decodes and publishes the next record. The cursor only advances once the
+// publish succeeded, so a dropped connection retries the same record.
+static bool replay_next_record() {
+  ChunkCursor& chunk = replayChunk;
+  size_t pos = chunk.pos;
+  uint32_t dt;
+  if (!get_varint(chunk.data, chunk.header.length, pos, dt) || pos >= chunk.header.length) {
+    chunk.remaining = 0; // Corrupt chunk, skip the rest of it
+    return false;
+  }
+  uint8_t channel = chunk.data[pos++];
+  if (channel >= NUM_POWER_CHANNELS) {
+    chunk.remaining = 0;
+    return false;
+  }
+
+  int32_t values[RECORD_FIELDS];
+  for (int f = 0; f < RECORD_FIELDS; f++) {
+    uint32_t raw;
+    if (!get_varint(chunk.data, chunk.header.length, pos, raw)) {
+      chunk.remaining = 0;
+      return false;
+    }
+    values[f] = chunk.last[channel][f] + unzigzag(raw);
+  }
+  uint32_t timestamp_ms = chunk.last_ms + dt;
+
+  // {"ch":2,"boot":41234,"ts":123456789,"age":3600,"v":13.215,"i":512,"p":6763}
+  // "age" (seconds before now) is only known for records from this boot.
+  char payload[128];
+  int len = snprintf(payload, sizeof(payload), "{\"ch\":%u,\"boot\":%u,\"ts\":%lu,", channel + 1,
+                     chunk.header.boot_id, (unsigned long)timestamp_ms);
+  if (chunk.header.boot_id == bootId) {
+    len += snprintf(payload + len, sizeof(payload) - len, "\"age\":%lu,",
+                    (unsigned long)((millis() - timestamp_ms) / 1000));
+  }
+  len += snprintf(payload + len, sizeof(payload) - len, "\"v\":");
+  len += format_fixed(payload + len, sizeof(payload) - len, values[0], 3, 3);
+  snprintf(payload + len, sizeof(payload) - len, ",\"i\":%ld,\"p\":%ld}", (long)values[1], (long)values[2]);
+  if (!mqtt_publish(MQTT_TOPIC_TELEMETRY_HISTORY, payload, false, false)) return false; // Every record counts
+
+  chunk.pos = pos;
+  chunk.last_ms = timestamp_ms;
+  for (int f = 0; f < RECORD_FIELDS; f++) chunk.last[channel][f] = values[f];
+  chunk.remaining--;
+  recordsReplayed++;
+  return true;
+}
+
+void loop_telemetry_buffer() {
+  if (!mqtt_connected()) return;
+  if (millis() - lastReplayTime < REPLAY_INTERVAL) return;
+  lastReplayTime = millis();
+
+  if (replayChunk.remaining == 0 && !load_replay_chunk()) return;
+  replay_next_record();
+}
+
+uint32_t telemetry_buffer_pending_bytes() {
+  uint32_t pending = fillChunk.header.length + (spillSize - spillReadOffset);
+  if (replayChunk.remaining > 0) pending += replayChunk.header.length - replayChunk.pos;
+  return pending;
+}
+
+void print_telemetry_buffer_stats() {
+  Serial.printf("Telemetry buffer: %lu buffered, %lu replayed, %lu dropped, %lu chunks spilled, %lu bytes pending\n",
+                recordsBuffered, recordsReplayed, recordsDropped, chunksSpilled,
+                (unsigned long)telemetry_buffer_pending_bytes());
+}
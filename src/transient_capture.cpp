@@ -0,0 +1,132 @@
+#include <Arduino.h>
+#include <atomic>
+#include "transient_capture.h"
+#include "connections.h"
+#include "config.h"
+
+static const unsigned long CAPTURE_HOLDOFF = 2000; // ms between captures, so a sustained overload isn't a flood
+
+// --- Pre-Trigger History (sampling task only) ---
+struct PreTriggerRing {
+  int32_t current_ma[CAPTURE_PRE_SAMPLES];
+  uint32_t timestamp_us[CAPTURE_PRE_SAMPLES];
+  uint16_t head;
+  uint16_t count;
+};
+static PreTriggerRing preTrigger[NUM_POWER_CHANNELS];
+
+// --- Hand-off ---
+// The sampling task owns `capture` while captureReady is false, loop() while it is true.
+static TransientCapture capture;
+static std::atomic<bool> captureReady{false};
+static bool captureInProgress = false;
+static unsigned long lastCaptureTime = 0;
+
+static volatile unsigned long capturesTaken = 0;
+static volatile unsigned long capturesSkipped = 0;
+static unsigned long capturesPublished = 0;
+
+void capture_note_sample(uint8_t channel, uint32_t timestamp_us, int32_t current_ua) {
+  if (channel >= NUM_POWER_CHANNELS) return;
+  PreTriggerRing& ring = preTrigger[channel];
+  ring.current_ma[ring.head] = current_ua / 1000;
+  ring.timestamp_us[ring.head] = timestamp_us;
+  ring.head = (ring.head + 1) % CAPTURE_PRE_SAMPLES;
+  if (ring.count < CAPTURE_PRE_SAMPLES) ring.count++;
+}
+
+TransientCapture* capture_acquire(uint8_t channel, int32_t limit_ma) {
+  if (channel >= NUM_POWER_CHANNELS) return nullptr;
+  if (captureReady.load(std::memory_order_acquire) || captureInProgress ||
+      (lastCaptureTime != 0 && millis() - lastCaptureTime < CAPTURE_HOLDOFF)) {
+    capturesSkipped = capturesSkipped + 1;
+    return nullptr;
+  }
+  captureInProgress = true;
+
+  // Copy the history oldest-first
+  const PreTriggerRing& ring = preTrigger[channel];
+  int oldest = (ring.head - ring.count + CAPTURE_PRE_SAMPLES) % CAPTURE_PRE_SAMPLES;
+  for (int i = 0; i < ring.count; i++) {
+    capture.pre_ma[i] = ring.current_ma[(oldest + i) % CAPTURE_PRE_SAMPLES];
+  }
+  capture.pre_count = ring.count;
+  capture.pre_interval_us = 0;
+  if (ring.count > 1) {
+    int newest = (ring.head - 1 + CAPTURE_PRE_SAMPLES) % CAPTURE_PRE_SAMPLES;
+    capture.pre_interval_us = (ring.timestamp_us[newest] - ring.timestamp_us[oldest]) / (ring.count - 1);
+  }
+
+  capture.channel = channel;
+  capture.limit_ma = limit_ma;
+  capture.post_count = 0;
+  capture.post_interval_us = 0;
+  return &capture;
+}
+
+void capture_commit() {
+  captureInProgress = false;
+  lastCaptureTime = millis();
+  capturesTaken = capturesTaken + 1;
+  captureReady.store(true, std::memory_order_release);
+}
+
+void capture_abort() {
+  captureInProgress = false;
+}
+
+// --- Publishing ---
+// {"ch":3,"name":"Load","limit_ma":6000,"peak_ma":9120,"pre_dt_us":35714,
+//  "post_dt_us":140,"pre":[...],"post":[...]}
+// Written twice: once into a byte counter for the MQTT length, once to the client.
+class ByteCounter : public Print {
+public:
+  size_t count = 0;
+  size_t write(uint8_t) override { count++; return 1; }
+  size_t write(const uint8_t*, size_t size) override { count += size; return size; }
+};
+
+static void print_samples(Print& out, const int32_t* samples, int count) {
+  out.print('[');
+  for (int i = 0; i < count; i++) {
+    if (i > 0) out.print(',');
+    out.print((long)samples[i]);
+  }
+  out.print(']');
+}
+
+static void print_capture(Print& out, const TransientCapture& c) {
+  int32_t peak = 0;
+  for (int i = 0; i < c.post_count; i++) {
+    if (abs(c.post_ma[i]) > abs(peak)) peak = c.post_ma[i];
+  }
+  out.printf("{\"ch\":%u,\"name\":\"%s\",\"limit_ma\":%ld,\"peak_ma\":%ld,\"pre_dt_us\":%lu,\"post_dt_us\":%lu,\"pre\":",
+             c.channel + 1, POWER_CHANNELS[c.channel].name, (long)c.limit_ma, (long)peak,
+             (unsigned long)c.pre_interval_us, (unsigned long)c.post_interval_us);
+  print_samples(out, c.pre_ma, c.pre_count);
+  out.print(",\"post\":");
+  print_samples(out, c.post_ma, c.post_count);
+  out.print('}');
+}
+
+// Called from the network task, the only one allowed to touch the client
+void loop_transient_capture() {
+  if (!captureReady.load(std::memory_order_acquire)) return;
+  if (!client.connected()) return; // Keep it until the broker is back
+
+  ByteCounter counter;
+  print_capture(counter, capture);
+  if (client.beginPublish(MQTT_TOPIC_TRANSIENT_CAPTURE, counter.count, false)) {
+    print_capture(client, capture);
+    if (client.endPublish()) {
+      capturesPublished++;
+      mqtt_count_sent(strlen(MQTT_TOPIC_TRANSIENT_CAPTURE), counter.count);
+    }
+  }
+  captureReady.store(false, std::memory_order_release); // One attempt; a broken stream isn't worth retrying
+}
+
+void print_transient_capture_stats() {
+  Serial.printf("Transient captures: %lu taken, %lu published, %lu skipped\n",
+                capturesTaken, capturesPublished, capturesSkipped);
+}
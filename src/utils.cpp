@@ -4,12 +4,62 @@
 // --- Buffer for formatted string ---
 static char formatBuffer[20]; // <---- ADDED
 
+static const uint32_t POW10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+// --- Fixed-Point Formatting ---
+// Digits are generated right to left into a scratch buffer, using 32-bit
+// division whenever the value fits (64-bit division is a libgcc call on the ESP32).
+int format_fixed(char* out, size_t size, int64_t value, int scale, int decimals, const char* unit, bool show_sign) {
+  if (scale > 9 || decimals > 9 || scale < 0 || decimals < 0) return 0;
+
+  bool negative = value < 0;
+  uint64_t magnitude = negative ? 0 - (uint64_t)value : (uint64_t)value;
+  if (decimals < scale) {
+    uint32_t divisor = POW10[scale - decimals];
+    magnitude = (magnitude + divisor / 2) / divisor;
+  } else if (decimals > scale) {
+    magnitude *= POW10[decimals - scale];
+  }
+  if (magnitude == 0) negative = false; // No "-0.00"
+
+  char digits[24];
+  int n = 0;
+  while (magnitude > 0xFFFFFFFFULL) {
+    digits[n++] = '0' + (char)(magnitude % 10);
+    magnitude /= 10;
+  }
+  uint32_t small = (uint32_t)magnitude;
+  do {
+    digits[n++] = '0' + (char)(small % 10);
+    small /= 10;
+  } while (small != 0);
+  while (n <= decimals) digits[n++] = '0'; // At least one digit before the point
+
+  size_t unit_len = unit != nullptr ? strlen(unit) : 0;
+  size_t length = (negative || show_sign ? 1 : 0) + n + (decimals > 0 ? 1 : 0) + unit_len;
+  if (length + 1 > size) {
+    if (size > 0) out[0] = '\0';
+    return 0;
+  }
+
+  char* p = out;
+  if (negative) *p++ = '-';
+  else if (show_sign) *p++ = '+';
+  while (n > 0) {
+    if (n == decimals) *p++ = '.';
+    *p++ = digits[--n];
+  }
+  if (unit_len > 0) memcpy(p, unit, unit_len);
+  p[unit_len] = '\0';
+  return (int)length;
+}
+
 // --- Helper function to format large numbers with units ---
-const char* format_large_number(float value) { // <---- ADDED
-  if (abs(value) >= 1000) {
-    sprintf(formatBuffer, "%.2f A", value / 1000.0);
+const char* format_large_number(int32_t milliamps) { // <---- ADDED
+  if (milliamps >= 1000 || milliamps <= -1000) {
+    format_fixed(formatBuffer, sizeof(formatBuffer), milliamps, 3, 2, " A");
   } else {
-    sprintf(formatBuffer, "%.0f mA", value);
+    format_fixed(formatBuffer, sizeof(formatBuffer), milliamps, 0, 0, " mA");
   }
   return formatBuffer;
 }
@@ -0,0 +1,148 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <unity.h>
+#include "battery_soc.h"
+
+// Host tests for the SoC engine: recorded (time, voltage, current) traces
+// from the battery channel are replayed through battery_soc_update() against
+// the model the firmware is configured with. Run with `pio test -e native`.
+
+extern const BatteryModel BATTERY_MODEL;
+
+#ifndef TRACE_DIR
+#define TRACE_DIR "test/test_battery_soc"
+#endif
+
+static const int MAX_TRACE_ROWS = 2000;
+
+struct TraceRow {
+  uint32_t time_s;
+  float voltage;
+  float current_ma;
+};
+
+struct Trace {
+  TraceRow rows[MAX_TRACE_ROWS];
+  int count;
+};
+
+static Trace trace;
+
+// CSV: time_s,voltage_v,current_ma; lines starting with '#' are comments
+static void load_trace(const char* name) {
+  char path[128];
+  snprintf(path, sizeof(path), "%s/%s", TRACE_DIR, name);
+  FILE* file = fopen(path, "r");
+  TEST_ASSERT_NOT_NULL_MESSAGE(file, path);
+
+  char line[96];
+  trace.count = 0;
+  while (fgets(line, sizeof(line), file) != nullptr && trace.count < MAX_TRACE_ROWS) {
+    if (line[0] == '#') continue;
+    TraceRow& row = trace.rows[trace.count];
+    unsigned long time_s;
+    if (sscanf(line, "%lu,%f,%f", &time_s, &row.voltage, &row.current_ma) != 3) continue;
+    row.time_s = (uint32_t)time_s;
+    trace.count++;
+  }
+  fclose(file);
+  TEST_ASSERT_TRUE(trace.count > 1);
+}
+
+// Feeds the rows with from_s <= time < to_s, as the sampler would. Timestamps
+// wrap at 2^32 us (~71.6 min) exactly like micros(); rest_90min.csv crosses it.
+static void replay(BatterySoc& state, uint32_t from_s, uint32_t to_s) {
+  for (int i = 0; i < trace.count; i++) {
+    const TraceRow& row = trace.rows[i];
+    if (row.time_s < from_s || row.time_s >= to_s) continue;
+    uint32_t timestamp_us = (uint32_t)((uint64_t)row.time_s * 1000000ULL);
+    battery_soc_update(state, BATTERY_MODEL, row.voltage, row.current_ma, timestamp_us);
+  }
+}
+
+static void replay_all(BatterySoc& state) {
+  replay(state, 0, UINT32_MAX);
+}
+
+void test_ocv_table_interpolates() {
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.95f, battery_ocv_soc(BATTERY_MODEL, 12.6f));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.625f, battery_ocv_soc(BATTERY_MODEL, 12.3f));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.0f, battery_ocv_soc(BATTERY_MODEL, 11.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f, battery_ocv_soc(BATTERY_MODEL, 13.5f));
+}
+
+// 2 A for 1 h is 2 Ah, a tenth of the configured 20 Ah
+void test_coulomb_counting_discharge() {
+  load_trace("discharge_2a_1h.csv");
+  BatterySoc state;
+  battery_soc_init(state, BATTERY_MODEL, 12.6f);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.95f, (float)state.soc);
+
+  replay_all(state);
+  TEST_ASSERT_FLOAT_WITHIN(0.002f, 0.85f, (float)state.soc);
+}
+
+// Charge current counts at the configured efficiency until one is measured
+void test_coulomb_counting_charge() {
+  load_trace("charge_2a_1h.csv");
+  BatterySoc state;
+  battery_soc_init(state, BATTERY_MODEL, 12.2f);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.5f, (float)state.soc);
+
+  replay_all(state);
+  float expected = 0.5f + 0.1f * BATTERY_MODEL.initial_efficiency;
+  TEST_ASSERT_FLOAT_WITHIN(0.002f, expected, (float)state.soc);
+}
+
+// A steady 0.1/h discharge: the regression should see the slope and project
+// the remaining charge, and report no time-to-full
+void test_time_to_empty_regression() {
+  load_trace("discharge_2a_1h.csv");
+  BatterySoc state;
+  battery_soc_init(state, BATTERY_MODEL, 12.6f);
+  replay_all(state);
+
+  TEST_ASSERT_FLOAT_WITHIN(0.2f, (float)state.soc / 0.1f, state.tte_hours);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, state.ttf_hours);
+}
+
+void test_time_to_full_regression() {
+  load_trace("charge_2a_1h.csv");
+  BatterySoc state;
+  battery_soc_init(state, BATTERY_MODEL, 12.2f);
+  replay_all(state);
+
+  float rate = 0.1f * BATTERY_MODEL.initial_efficiency; // SoC per hour
+  TEST_ASSERT_FLOAT_WITHIN(0.3f, (1.0f - (float)state.soc) / rate, state.ttf_hours);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, state.tte_hours);
+}
+
+// Booted on a surface charge (12.8 V reads as full), then rests at 12.2 V.
+// Nothing moves until rest_time_s has passed; after that the estimate
+// converges on the OCV value instead of the drifted coulomb count.
+void test_ocv_correction_after_rest() {
+  load_trace("rest_90min.csv");
+  BatterySoc state;
+  battery_soc_init(state, BATTERY_MODEL, 12.8f);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f, (float)state.soc);
+
+  replay(state, 0, BATTERY_MODEL.rest_time_s - 5);
+  TEST_ASSERT_FLOAT_WITHIN(0.002f, 1.0f, (float)state.soc);
+
+  replay(state, BATTERY_MODEL.rest_time_s - 5, UINT32_MAX);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, battery_ocv_soc(BATTERY_MODEL, 12.2f), (float)state.soc);
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ocv_table_interpolates);
+  RUN_TEST(test_coulomb_counting_discharge);
+  RUN_TEST(test_coulomb_counting_charge);
+  RUN_TEST(test_time_to_empty_regression);
+  RUN_TEST(test_time_to_full_regression);
+  RUN_TEST(test_ocv_correction_after_rest);
+  return UNITY_END();
+}